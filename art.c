@@ -0,0 +1,711 @@
+/**
+ * File: art.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "mylib.h"
+#include "art.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Only the first MAX_PREFIX bytes of a compressed path are kept in its
+   node. Searches skip the rest and check the whole key at the leaf, and
+   inserts compare it with a key from under the node. */
+#define MAX_PREFIX 10
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define NODE4_OF(n) ((struct art_node4 *) (n))
+#define NODE16_OF(n) ((struct art_node16 *) (n))
+#define NODE48_OF(n) ((struct art_node48 *) (n))
+#define NODE256_OF(n) ((struct art_node256 *) (n))
+#define LEAF_OF(n) ((struct art_leaf *) (n))
+
+typedef enum { NODE4, NODE16, NODE48, NODE256, LEAF } art_node_t;
+
+/**
+ * Struct: art_node
+ * Purpose: declares the variables every inner node starts with. The
+ * prefix is the path compressed into the node: prefix_len bytes which
+ * every key under the node has before the byte choosing its child.
+ */
+typedef struct art_node *anode;
+
+struct art_node {
+  unsigned char type;
+  unsigned char prefix[MAX_PREFIX];
+  unsigned short num_children;
+  unsigned int prefix_len;
+};
+
+/**
+ * Struct: art_node4, art_node16
+ * Purpose: declares the variables for the small inner nodes, which keep
+ * the key byte of each child in sorted order beside it.
+ */
+struct art_node4 {
+  struct art_node n;
+  unsigned char keys[4];
+  anode children[4];
+};
+
+struct art_node16 {
+  struct art_node n;
+  unsigned char keys[16];
+  anode children[16];
+};
+
+/**
+ * Struct: art_node48
+ * Purpose: declares the variables for a node with up to 48 children.
+ * child_index holds one more than the slot of the child for each key
+ * byte, or 0 if there is no child for it.
+ */
+struct art_node48 {
+  struct art_node n;
+  unsigned char child_index[256];
+  anode children[48];
+};
+
+/**
+ * Struct: art_node256
+ * Purpose: declares the variables for a node with a slot for the child
+ * of every key byte.
+ */
+struct art_node256 {
+  struct art_node n;
+  anode children[256];
+};
+
+/**
+ * Struct: art_leaf
+ * Purpose: declares the variables for a leaf, which holds a whole key
+ * and its frequency. Leaves start with a type like the inner nodes, so
+ * they can be stored as children in the same way.
+ */
+struct art_leaf {
+  unsigned char type;
+  int frequency;
+  char key[1];
+};
+
+/**
+ * Struct: artrec
+ * Purpose: declares the variables for an adaptive radix tree. The leaves
+ * are allocated from an arena, and the inner nodes one at a time since
+ * they are replaced by bigger ones as they fill.
+ */
+struct artrec {
+  anode root;
+  arena leaf_arena;
+};
+
+/**
+ * Function: node_new
+ * Purpose: creates an inner node with no children and no prefix.
+ *
+ * @param type the kind of inner node.
+ * @return the new node.
+ */
+static anode node_new(art_node_t type){
+  size_t size;
+  anode n;
+
+  switch (type){
+  case NODE4:
+    size = sizeof(struct art_node4);
+    break;
+  case NODE16:
+    size = sizeof(struct art_node16);
+    break;
+  case NODE48:
+    size = sizeof(struct art_node48);
+    break;
+  default:
+    size = sizeof(struct art_node256);
+    break;
+  }
+  n = emalloc(size);
+  memset(n, 0, size);
+  n->type = type;
+  return n;
+}
+
+/**
+ * Function: leaf_new
+ * Purpose: creates a leaf holding a copy of a key.
+ *
+ * @param a the tree whose arena the leaf goes in.
+ * @param key the key, including its terminating null byte.
+ * @param len the length of the key with its null byte.
+ * @param freq the frequency of the key.
+ * @return the new leaf, as a child for an inner node.
+ */
+static anode leaf_new(art a, const unsigned char *key, int len, int freq){
+  struct art_leaf *l;
+
+  l = arena_alloc(a->leaf_arena, offsetof(struct art_leaf, key) + len);
+  l->type = LEAF;
+  l->frequency = freq;
+  memcpy(l->key, key, len);
+  return (anode) l;
+}
+
+/**
+ * Function: find_child
+ * Purpose: finds the child of an inner node for a key byte.
+ *
+ * @param n the inner node.
+ * @param c the key byte.
+ * @return the slot holding the child, or NULL if there is none.
+ */
+static anode *find_child(anode n, unsigned char c){
+  struct art_node4 *p4;
+  struct art_node16 *p16;
+  int i;
+#ifdef __SSE2__
+  unsigned int mask;
+#endif
+
+  switch (n->type){
+  case NODE4:
+    p4 = NODE4_OF(n);
+    for (i = 0; i < n->num_children; i++){
+      if (p4->keys[i] == c){
+        return &p4->children[i];
+      }
+    }
+    return NULL;
+  case NODE16:
+    p16 = NODE16_OF(n);
+#ifdef __SSE2__
+    /* Compare the byte with all 16 keys at once. */
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_set1_epi8((char) c),
+        _mm_loadu_si128((const __m128i *) p16->keys)));
+    mask &= (1u << n->num_children) - 1;
+    return mask != 0 ? &p16->children[__builtin_ctz(mask)] : NULL;
+#else
+    for (i = 0; i < n->num_children; i++){
+      if (p16->keys[i] == c){
+        return &p16->children[i];
+      }
+    }
+    return NULL;
+#endif
+  case NODE48:
+    i = NODE48_OF(n)->child_index[c];
+    return i != 0 ? &NODE48_OF(n)->children[i - 1] : NULL;
+  default:
+    return NODE256_OF(n)->children[c] != NULL
+      ? &NODE256_OF(n)->children[c] : NULL;
+  }
+}
+
+/**
+ * Function: copy_header
+ * Purpose: gives a node the number of children and the prefix of the
+ * node it replaces.
+ *
+ * @param to the new node.
+ * @param from the node it replaces.
+ */
+static void copy_header(anode to, anode from){
+  to->num_children = from->num_children;
+  to->prefix_len = from->prefix_len;
+  memcpy(to->prefix, from->prefix, MAX_PREFIX);
+}
+
+/**
+ * Function: add_child
+ * Purpose: adds a child to an inner node for a key byte it has no child
+ * for. A full node is replaced by the next size up, which is stored
+ * where the node was.
+ *
+ * @param ref where the node is stored.
+ * @param n the inner node.
+ * @param c the key byte.
+ * @param child the new child.
+ */
+static void add_child(anode *ref, anode n, unsigned char c, anode child){
+  struct art_node4 *p4;
+  struct art_node16 *p16;
+  struct art_node48 *p48;
+  anode bigger;
+  int i, num = n->num_children;
+
+  switch (n->type){
+  case NODE4:
+    p4 = NODE4_OF(n);
+    if (num < 4){
+      for (i = 0; i < num && p4->keys[i] < c; i++)
+        ;
+      memmove(p4->keys + i + 1, p4->keys + i, num - i);
+      memmove(p4->children + i + 1, p4->children + i,
+              (num - i) * sizeof p4->children[0]);
+      p4->keys[i] = c;
+      p4->children[i] = child;
+      n->num_children++;
+      return;
+    }
+    bigger = node_new(NODE16);
+    copy_header(bigger, n);
+    memcpy(NODE16_OF(bigger)->keys, p4->keys, 4);
+    memcpy(NODE16_OF(bigger)->children, p4->children, sizeof p4->children);
+    break;
+  case NODE16:
+    p16 = NODE16_OF(n);
+    if (num < 16){
+      for (i = 0; i < num && p16->keys[i] < c; i++)
+        ;
+      memmove(p16->keys + i + 1, p16->keys + i, num - i);
+      memmove(p16->children + i + 1, p16->children + i,
+              (num - i) * sizeof p16->children[0]);
+      p16->keys[i] = c;
+      p16->children[i] = child;
+      n->num_children++;
+      return;
+    }
+    bigger = node_new(NODE48);
+    copy_header(bigger, n);
+    for (i = 0; i < 16; i++){
+      NODE48_OF(bigger)->child_index[p16->keys[i]] = i + 1;
+      NODE48_OF(bigger)->children[i] = p16->children[i];
+    }
+    break;
+  case NODE48:
+    p48 = NODE48_OF(n);
+    if (num < 48){
+      /* Children are never removed, so the slots in use are the first
+         num_children. */
+      p48->children[num] = child;
+      p48->child_index[c] = num + 1;
+      n->num_children++;
+      return;
+    }
+    bigger = node_new(NODE256);
+    copy_header(bigger, n);
+    for (i = 0; i < 256; i++){
+      if (p48->child_index[i] != 0){
+        NODE256_OF(bigger)->children[i] =
+          p48->children[p48->child_index[i] - 1];
+      }
+    }
+    break;
+  default:
+    NODE256_OF(n)->children[c] = child;
+    n->num_children++;
+    return;
+  }
+  free(n);
+  *ref = bigger;
+  add_child(ref, bigger, c, child);
+}
+
+/**
+ * Function: minimum
+ * Purpose: finds the leaf with the smallest key under a node.
+ *
+ * @param n the node.
+ * @return the leaf.
+ */
+static struct art_leaf *minimum(anode n){
+  int i;
+
+  while (n->type != LEAF){
+    switch (n->type){
+    case NODE4:
+      n = NODE4_OF(n)->children[0];
+      break;
+    case NODE16:
+      n = NODE16_OF(n)->children[0];
+      break;
+    case NODE48:
+      for (i = 0; NODE48_OF(n)->child_index[i] == 0; i++)
+        ;
+      n = NODE48_OF(n)->children[NODE48_OF(n)->child_index[i] - 1];
+      break;
+    default:
+      for (i = 0; NODE256_OF(n)->children[i] == NULL; i++)
+        ;
+      n = NODE256_OF(n)->children[i];
+      break;
+    }
+  }
+  return LEAF_OF(n);
+}
+
+/**
+ * Function: prefix_mismatch
+ * Purpose: finds how much of the prefix of a node a key matches. Bytes
+ * of the prefix past those kept in the node are read from a leaf under
+ * it, since every key under the node has the whole prefix.
+ *
+ * @param n the inner node.
+ * @param key the key.
+ * @param depth the position in the key the prefix starts at.
+ * @return the number of bytes of the prefix matched.
+ */
+static unsigned int prefix_mismatch(anode n, const unsigned char *key,
+                                    int depth){
+  const unsigned char *rest;
+  unsigned int i;
+
+  for (i = 0; i < MIN(n->prefix_len, MAX_PREFIX); i++){
+    if (n->prefix[i] != key[depth + i]){
+      return i;
+    }
+  }
+  if (n->prefix_len > MAX_PREFIX){
+    rest = (const unsigned char *) minimum(n)->key + depth;
+    for (; i < n->prefix_len; i++){
+      if (rest[i] != key[depth + i]){
+        return i;
+      }
+    }
+  }
+  return i;
+}
+
+/**
+ * Function: art_insert_freq
+ * Purpose: inserts a string into the tree with the given frequency, or
+ * adds the frequency to it if it is already there. Keys are stored with
+ * their null byte, so no key is a prefix of another and every key ends
+ * at a leaf. Walking down one byte at a time, a new key either splits
+ * the prefix of a node, splits a leaf into a node holding both keys, or
+ * becomes a new child of the last node it reaches.
+ *
+ * @param a the tree.
+ * @param str is a pointer to the string to be inserted.
+ * @param freq how many times the string is being inserted.
+ * @return the frequency of the string afterwards.
+ */
+int art_insert_freq(art a, char *str, int freq){
+  const unsigned char *key = (const unsigned char *) str;
+  int len = strlen(str) + 1, depth = 0;
+  anode *ref = &a->root, *child, n, split;
+  struct art_leaf *l;
+  unsigned int diff;
+
+  while (*ref != NULL){
+    n = *ref;
+    if (n->type == LEAF){
+      l = LEAF_OF(n);
+      if (strcmp(l->key, str) == 0){
+        l->frequency += freq;
+        return l->frequency;
+      }
+      split = node_new(NODE4);
+      for (diff = 0; (unsigned char) l->key[depth + diff] == key[depth + diff];
+           diff++)
+        ;
+      split->prefix_len = diff;
+      memcpy(split->prefix, key + depth, MIN(diff, MAX_PREFIX));
+      add_child(&split, split, l->key[depth + diff], n);
+      add_child(&split, split, key[depth + diff],
+                leaf_new(a, key, len, freq));
+      *ref = split;
+      return freq;
+    }
+
+    if (n->prefix_len > 0){
+      diff = prefix_mismatch(n, key, depth);
+      if (diff < n->prefix_len){
+        split = node_new(NODE4);
+        split->prefix_len = diff;
+        memcpy(split->prefix, key + depth, MIN(diff, MAX_PREFIX));
+        if (n->prefix_len <= MAX_PREFIX){
+          add_child(&split, split, n->prefix[diff], n);
+          n->prefix_len -= diff + 1;
+          memmove(n->prefix, n->prefix + diff + 1,
+                  MIN(n->prefix_len, MAX_PREFIX));
+        } else {
+          l = minimum(n);
+          add_child(&split, split, l->key[depth + diff], n);
+          n->prefix_len -= diff + 1;
+          memcpy(n->prefix, l->key + depth + diff + 1,
+                 MIN(n->prefix_len, MAX_PREFIX));
+        }
+        add_child(&split, split, key[depth + diff],
+                  leaf_new(a, key, len, freq));
+        *ref = split;
+        return freq;
+      }
+      depth += n->prefix_len;
+    }
+
+    child = find_child(n, key[depth]);
+    if (child == NULL){
+      add_child(ref, n, key[depth], leaf_new(a, key, len, freq));
+      return freq;
+    }
+    ref = child;
+    depth++;
+  }
+
+  *ref = leaf_new(a, key, len, freq);
+  return freq;
+}
+
+/**
+ * Function: art_insert
+ * Purpose: inserts a string into the tree.
+ *
+ * @param a the tree.
+ * @param str is a pointer to the string to be inserted.
+ * @return 1 if the string is new, or its frequency if it was already
+ * in the tree.
+ */
+int art_insert(art a, char *str){
+
+  return art_insert_freq(a, str, 1);
+}
+
+/**
+ * Function: art_step
+ * Purpose: moves a search one inner node down the tree, past the prefix
+ * kept in the node and the byte choosing its child.
+ *
+ * @param n the inner node.
+ * @param key the string being searched for.
+ * @param len the length of the string, counting its terminating null.
+ * @param depth how many bytes of the string the search has used, which
+ * is moved on.
+ * @return the child to go on to, or NULL if the string is not in the
+ * tree.
+ */
+static anode art_step(anode n, const unsigned char *key, unsigned int len,
+                      unsigned int *depth){
+  unsigned int i;
+  anode *child;
+
+  if (n->prefix_len > 0){
+    for (i = 0; i < MIN(n->prefix_len, MAX_PREFIX); i++){
+      if (n->prefix[i] != key[*depth + i]){
+        return NULL;
+      }
+    }
+    *depth += n->prefix_len;
+    if (*depth >= len){
+      return NULL;
+    }
+  }
+  child = find_child(n, key[*depth]);
+  if (child == NULL){
+    return NULL;
+  }
+  (*depth)++;
+  return *child;
+}
+
+/**
+ * Function: art_search
+ * Purpose: searches the tree for a string, taking one step per byte of
+ * the string however many keys the tree holds. Prefixes are only
+ * checked as far as they are kept in the nodes, so the key at the leaf
+ * reached is compared with the whole string.
+ *
+ * @param a the tree.
+ * @param str is a pointer to the string to search for.
+ * @return the frequency of the string, or 0 if it is not in the tree.
+ */
+int art_search(art a, char *str){
+  const unsigned char *key = (const unsigned char *) str;
+  unsigned int len = strlen(str) + 1, depth = 0;
+  anode n = a->root;
+
+  while (n != NULL){
+    if (n->type == LEAF){
+      return strcmp(LEAF_OF(n)->key, str) == 0 ? LEAF_OF(n)->frequency : 0;
+    }
+    n = art_step(n, key, len, &depth);
+  }
+  return 0;
+}
+
+/**
+ * Function: art_search_batch
+ * Purpose: searches the tree for many strings at once, moving the
+ * searches down the tree together one node per pass like
+ * btree_search_batch. The node each search goes on to is prefetched
+ * while the others take their step, so their cache misses overlap.
+ *
+ * @param a the tree.
+ * @param words the strings to search for.
+ * @param n the number of strings.
+ * @param results set to the frequency of each string in the tree, 0 for
+ * the others.
+ */
+void art_search_batch(art a, char **words, int n, int *results){
+  anode *nodes = emalloc((n + 1) * sizeof nodes[0]);
+  unsigned int *depths = emalloc((n + 1) * sizeof depths[0]);
+  unsigned int *lens = emalloc((n + 1) * sizeof lens[0]);
+  int i, active = 0;
+
+  for (i = 0; i < n; i++){
+    nodes[i] = a->root;
+    depths[i] = 0;
+    lens[i] = strlen(words[i]) + 1;
+    results[i] = 0;
+    if (nodes[i] != NULL){
+      active++;
+    }
+  }
+  while (active > 0){
+    for (i = 0; i < n; i++){
+      if (nodes[i] == NULL){
+        continue;
+      }
+      if (nodes[i]->type == LEAF){
+        if (strcmp(LEAF_OF(nodes[i])->key, words[i]) == 0){
+          results[i] = LEAF_OF(nodes[i])->frequency;
+        }
+        nodes[i] = NULL;
+      } else {
+        nodes[i] = art_step(nodes[i], (const unsigned char *) words[i],
+                            lens[i], &depths[i]);
+      }
+      if (nodes[i] == NULL){
+        active--;
+      } else {
+        PREFETCH(nodes[i]);
+      }
+    }
+  }
+  free(nodes);
+  free(depths);
+  free(lens);
+}
+
+/**
+ * Function: art_inorder_aux
+ * Purpose: performs a function on the keys under a node in sorted order.
+ * Children are kept in key byte order, and the null byte ending a key
+ * sorts before any other, so this is the order strcmp gives.
+ *
+ * @param n the node.
+ * @param f another function passed in with parameters freq and str.
+ */
+static void art_inorder_aux(anode n, void f(int freq, char *str)){
+  int i;
+
+  switch (n->type){
+  case LEAF:
+    f(LEAF_OF(n)->frequency, LEAF_OF(n)->key);
+    break;
+  case NODE4:
+    for (i = 0; i < n->num_children; i++){
+      art_inorder_aux(NODE4_OF(n)->children[i], f);
+    }
+    break;
+  case NODE16:
+    for (i = 0; i < n->num_children; i++){
+      art_inorder_aux(NODE16_OF(n)->children[i], f);
+    }
+    break;
+  case NODE48:
+    for (i = 0; i < 256; i++){
+      if (NODE48_OF(n)->child_index[i] != 0){
+        art_inorder_aux(NODE48_OF(n)->children[
+                          NODE48_OF(n)->child_index[i] - 1], f);
+      }
+    }
+    break;
+  default:
+    for (i = 0; i < 256; i++){
+      if (NODE256_OF(n)->children[i] != NULL){
+        art_inorder_aux(NODE256_OF(n)->children[i], f);
+      }
+    }
+    break;
+  }
+}
+
+/**
+ * Function: art_inorder
+ * Purpose: traverses through the tree in sorted order and performs the
+ * given function on each key and its frequency.
+ *
+ * @param a the tree.
+ * @param f another function passed in with parameters freq and str.
+ */
+void art_inorder(art a, void f(int freq, char *str)){
+
+  if (a->root != NULL){
+    art_inorder_aux(a->root, f);
+  }
+}
+
+/**
+ * Function: art_free_aux
+ * Purpose: frees the inner nodes under and including a node. Leaves go
+ * with the arena.
+ *
+ * @param n the node.
+ */
+static void art_free_aux(anode n){
+  int i;
+
+  switch (n->type){
+  case LEAF:
+    return;
+  case NODE4:
+    for (i = 0; i < n->num_children; i++){
+      art_free_aux(NODE4_OF(n)->children[i]);
+    }
+    break;
+  case NODE16:
+    for (i = 0; i < n->num_children; i++){
+      art_free_aux(NODE16_OF(n)->children[i]);
+    }
+    break;
+  case NODE48:
+    for (i = 0; i < n->num_children; i++){
+      art_free_aux(NODE48_OF(n)->children[i]);
+    }
+    break;
+  default:
+    for (i = 0; i < 256; i++){
+      if (NODE256_OF(n)->children[i] != NULL){
+        art_free_aux(NODE256_OF(n)->children[i]);
+      }
+    }
+    break;
+  }
+  free(n);
+}
+
+/**
+ * Function: art_free
+ * Purpose: frees all the memory allocated to the tree.
+ *
+ * @param a the tree.
+ */
+void art_free(art a){
+
+  if (a->root != NULL){
+    art_free_aux(a->root);
+  }
+  arena_free(a->leaf_arena);
+  free(a);
+}
+
+/**
+ * Function: art_new
+ * Purpose: creates a new, empty adaptive radix tree.
+ *
+ * @return the new tree.
+ */
+art art_new(void){
+  art a = emalloc(sizeof *a);
+
+  a->root = NULL;
+  a->leaf_arena = arena_new();
+  return a;
+}
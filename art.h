@@ -0,0 +1,29 @@
+/**
+ * File: art.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef ART_H_
+#define ART_H_
+
+/**
+ * Struct: artrec
+ * Purpose: defines a struct type of artrec to structure an adaptive
+ * radix tree, which owns its nodes and keys.
+ */
+typedef struct artrec *art;
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the art.c file, based on
+ * their signatures.
+ */
+extern void art_free(art a);
+extern void art_inorder(art a, void f(int freq, char *str));
+extern int art_insert(art a, char *str);
+extern int art_insert_freq(art a, char *str, int freq);
+extern art art_new(void);
+extern int art_search(art a, char *str);
+extern void art_search_batch(art a, char **words, int n, int *results);
+
+#endif
@@ -3,16 +3,90 @@
  * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <getopt.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "tree.h"
+#include "art.h"
+#include "topk.h"
+#include "tokenizer.h"
 #include "htable.h"
+#include "bloom.h"
+#include "mphf.h"
+#include "output.h"
+#include "server.h"
 #include "mylib.h"
 
 #define TRUE 1
 #define FALSE 0
+#define CHECK_BATCH 64
+#define FILL_BATCH 256
+#define BLOOM_BITS 10
+
+/**
+ * Struct: fill_job
+ * Purpose: the share of the input filled into a hash table by one
+ * worker thread. A sharded job fills a private table of its own.
+ */
+struct fill_job {
+  htable h;
+  char *text;
+  size_t len;
+  int sharded;
+};
+
+/**
+ * Struct: check_file
+ * Purpose: one of the files checked with -c, and once a worker has
+ * checked it, its unknown words ready to print along with its counts
+ * and timing.
+ */
+struct check_file {
+  char *name;
+  char *text;
+  size_t len;
+  size_t size;
+  int unknown;
+  int false_hits;
+  int missing;
+  int done;
+  double time;
+};
+
+/**
+ * Struct: check_job
+ * Purpose: the dictionary the check workers all search, which none of
+ * them changes, and the files they take in turn. Exactly one of a, t,
+ * perfect and h is searched, and filter is consulted first if it is
+ * not NULL.
+ */
+struct check_job {
+  art a;
+  tree t;
+  mphf perfect;
+  htable h;
+  bloom filter;
+  int prefix;
+  struct check_file *files;
+  int num_files;
+  int next;
+  pthread_mutex_t lock;
+  pthread_cond_t checked;
+};
+
+/* Writers for stdout and stderr, which every word and table printed
+   goes through rather than stdio. */
+static output out;
+static output err;
 
 /**
  * Function: print_info
@@ -22,7 +96,533 @@
  * @param word is a pointer to the word in question. 
  */
 static void print_info(int freq, char *word) {
-  printf("%-4d %s\n", freq, word);
+  output_int(out, freq, -4);
+  output_putc(out, ' ');
+  output_puts(out, word);
+  output_putc(out, '\n');
+}
+
+/* The top words being kept for -k, which add_top_word gives the
+   frequency of each word in the dictionary. */
+static topk top_words;
+
+/**
+ * Function: add_top_word
+ * Purpose: offers a word and its frequency to the top words for -k.
+ *
+ * @param freq is the frequency of the word.
+ * @param word is a pointer to the word in question.
+ */
+static void add_top_word(int freq, char *word) {
+  topk_update(top_words, word, freq);
+}
+
+/* The Bloom filter for -F, which holds every word in the dictionary,
+   and the number of words count_filter_word has counted to size it. */
+static bloom filter;
+static int filter_words;
+
+/**
+ * Function: count_filter_word
+ * Purpose: counts a word of the dictionary, so the Bloom filter can be
+ * made big enough for them all.
+ *
+ * @param freq is the frequency of the word.
+ * @param word is a pointer to the word in question.
+ */
+static void count_filter_word(int freq, char *word) {
+  (void) freq;
+  (void) word;
+  filter_words++;
+}
+
+/**
+ * Function: add_filter_word
+ * Purpose: adds a word of the dictionary to the Bloom filter.
+ *
+ * @param freq is the frequency of the word.
+ * @param word is a pointer to the word in question.
+ */
+static void add_filter_word(int freq, char *word) {
+  (void) freq;
+  bloom_add(filter, word);
+}
+
+/**
+ * Function: wall_time
+ * Purpose: reads a monotonic wall clock, so timings stay meaningful when
+ * several threads share the work.
+ *
+ * @return the current time in seconds.
+ */
+static double wall_time(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Function: read_all
+ * Purpose: reads everything left in a stream into memory.
+ *
+ * @param stream the stream to read.
+ * @param len set to the number of bytes read.
+ * @return the bytes read, which the caller must free.
+ */
+static char *read_all(FILE *stream, size_t *len) {
+  size_t size = 65536;
+  char *text = emalloc(size);
+
+  *len = 0;
+  while ((*len += fread(text + *len, 1, size - *len, stream)) == size){
+    size *= 2;
+    text = erealloc(text, size);
+  }
+  return text;
+}
+
+/**
+ * Function: word_boundary
+ * Purpose: finds the first position at or after pos which getword would
+ * treat as the end of a word, so text can be split there without
+ * changing the words read from either side.
+ *
+ * @param text the text to split.
+ * @param len the length of the text.
+ * @param pos the position to start looking from.
+ * @return the position of the first separator from pos, or len.
+ */
+static size_t word_boundary(char *text, size_t len, size_t pos) {
+  while (pos < len && (isalnum((unsigned char) text[pos])
+		       || text[pos] == '\'')){
+    pos++;
+  }
+  return pos;
+}
+
+/**
+ * Function: fill_worker
+ * Purpose: reads the words in a fill_job and inserts them into its hash
+ * table, which is either shared and filled a batch at a time or private
+ * and filled a word at a time.
+ *
+ * @param arg the fill_job to work on.
+ * @return NULL.
+ */
+static void *fill_worker(void *arg) {
+  struct fill_job *job = arg;
+  char batch[FILL_BATCH][256];
+  char *words[FILL_BATCH];
+  char *word;
+  tokenizer in;
+  int i, n, len;
+
+  if (job->len == 0){
+    job->h = job->sharded == TRUE ? htable_new(113, LINEAR_P, XX_H, 0.75)
+      : job->h;
+    return NULL;
+  }
+  in = tokenizer_new_memory(job->text, job->len);
+  if (job->sharded == TRUE){
+    job->h = htable_new(113, LINEAR_P, XX_H, 0.75);
+    while (tokenizer_next(in, &word) != EOF){
+      htable_insert(job->h, word);
+    }
+    tokenizer_free(in);
+    return NULL;
+  }
+  for (i = 0; i < FILL_BATCH; i++){
+    words[i] = batch[i];
+  }
+  do {
+    n = 0;
+    while (n < FILL_BATCH && (len = tokenizer_next(in, &word)) != EOF){
+      memcpy(batch[n++], word, len + 1);
+    }
+    htable_insert_concurrent(job->h, words, n);
+  } while (n == FILL_BATCH);
+  tokenizer_free(in);
+  return NULL;
+}
+
+/**
+ * Function: parallel_fill
+ * Purpose: fills a hash table from a stream using several threads. The
+ * input is split into one piece per thread at word boundaries. Either
+ * every thread inserts into the same table, or each counts its piece in a
+ * private table and the private tables are merged in input order, which
+ * gives exactly the table a single thread would have built.
+ *
+ * @param h the hash table to fill.
+ * @param stream the stream to read words from.
+ * @param threads the number of threads to use.
+ * @param sharded TRUE to give each thread a private table.
+ */
+static void parallel_fill(htable h, FILE *stream, int threads,
+			  int sharded) {
+  struct fill_job *jobs = emalloc(threads * sizeof jobs[0]);
+  pthread_t *ids = emalloc(threads * sizeof ids[0]);
+  size_t len, from = 0, to;
+  char *text = read_all(stream, &len);
+  int i;
+
+  for (i = 0; i < threads; i++){
+    to = word_boundary(text, len, len / threads * (i + 1));
+    if (i == threads - 1 || to < from){
+      to = i == threads - 1 ? len : from;
+    }
+    jobs[i].h = h;
+    jobs[i].text = text + from;
+    jobs[i].len = to - from;
+    jobs[i].sharded = sharded;
+    pthread_create(&ids[i], NULL, fill_worker, &jobs[i]);
+    from = to;
+  }
+  for (i = 0; i < threads; i++){
+    pthread_join(ids[i], NULL);
+  }
+  for (i = 0; sharded == TRUE && i < threads; i++){
+    htable_merge(h, jobs[i].h);
+    htable_free(jobs[i].h);
+  }
+
+  free(text);
+  free(ids);
+  free(jobs);
+}
+
+/**
+ * Struct: key_stream
+ * Purpose: declares the variables for reading the keys of a hash table
+ * in the order they were first inserted, with their frequencies.
+ */
+struct key_stream {
+  htable h;
+  int next;
+};
+
+/**
+ * Function: next_word
+ * Purpose: reads the next word of a tokenizer, once.
+ *
+ * @param source the tokenizer.
+ * @param word set to the word.
+ * @param freq set to 1.
+ * @return the length of the word, or EOF.
+ */
+static int next_word(void *source, char **word, int *freq) {
+  *freq = 1;
+  return tokenizer_next(source, word);
+}
+
+/**
+ * Function: next_key
+ * Purpose: reads the next key of a key_stream with its frequency.
+ *
+ * @param source the key_stream.
+ * @param word set to the key.
+ * @param freq set to the frequency of the key.
+ * @return 0, or EOF once every key is read.
+ */
+static int next_key(void *source, char **word, int *freq) {
+  struct key_stream *keys = source;
+
+  if (keys->next == htable_num_keys(keys->h)){
+    return EOF;
+  }
+  *word = htable_key(keys->h, keys->next++, freq);
+  return 0;
+}
+
+/**
+ * Function: fill_tree
+ * Purpose: fills a tree from a stream of words and frequencies. Words
+ * are held back for as long as they come in sorted order, as a
+ * dictionary file does, and then the tree is built from them in one go
+ * in linear time instead of turning a bst into a list. Once a word is
+ * out of order the words held back go in one at a time in the order
+ * they came, followed by the rest, so the tree is the same as one
+ * filled a word at a time.
+ *
+ * @param t the tree to fill.
+ * @param source where the words come from.
+ * @param next reads the next word from source and its frequency,
+ * returning EOF once there are none left.
+ */
+static void fill_tree(tree t, void *source,
+		      int next(void *source, char **word, int *freq)) {
+  arena buffer = arena_new();
+  int size = 1024, n = 0, i, cmp, freq, sorted = TRUE;
+  char **keys = emalloc(size * sizeof keys[0]);
+  int *freqs = emalloc(size * sizeof freqs[0]);
+  char *word;
+
+  while (next(source, &word, &freq) != EOF){
+    if (sorted == FALSE){
+      tree_insert_freq(t, word, freq);
+      continue;
+    }
+    cmp = n > 0 ? strcmp(word, keys[n - 1]) : 1;
+    if (cmp == 0){
+      freqs[n - 1] += freq;
+    } else if (cmp > 0){
+      if (n == size){
+        size *= 2;
+        keys = erealloc(keys, size * sizeof keys[0]);
+        freqs = erealloc(freqs, size * sizeof freqs[0]);
+      }
+      keys[n] = arena_strdup(buffer, word);
+      freqs[n++] = freq;
+    } else {
+      for (i = 0; i < n; i++){
+        tree_insert_freq(t, keys[i], freqs[i]);
+      }
+      tree_insert_freq(t, word, freq);
+      sorted = FALSE;
+    }
+  }
+  if (sorted == TRUE){
+    tree_build_sorted(t, keys, freqs, n);
+  }
+
+  arena_free(buffer);
+  free(keys);
+  free(freqs);
+}
+
+/**
+ * Function: check_append
+ * Purpose: adds text to the unknown words of a file, which are kept
+ * until it is that file's turn to be printed.
+ *
+ * @param file the file.
+ * @param text the text to add.
+ * @param len the length of the text.
+ */
+static void check_append(struct check_file *file, const char *text,
+			 size_t len) {
+  if (file->len + len > file->size){
+    while (file->len + len > file->size){
+      file->size = file->size == 0 ? 4096 : 2 * file->size;
+    }
+    file->text = erealloc(file->text, file->size);
+  }
+  memcpy(file->text + file->len, text, len);
+  file->len += len;
+}
+
+/**
+ * Function: lookup_words
+ * Purpose: looks a batch of words up in the dictionary, so the searches
+ * can overlap their cache misses. Only the words the filter cannot rule
+ * out are looked up at all.
+ *
+ * @param job the dictionary.
+ * @param words the words.
+ * @param n the number of words, at most CHECK_BATCH.
+ * @param results set to the frequency of each word in the dictionary, 0
+ * for an unknown word.
+ * @return the number of words the filter let through that were not
+ * found.
+ */
+static int lookup_words(struct check_job *job, char **words, int n,
+			int *results) {
+  char *candidates[CHECK_BATCH];
+  int found[CHECK_BATCH];
+  int i, m = 0, false_hits = 0;
+
+  if (job->filter != NULL){
+    bloom_contains_batch(job->filter, words, n, results);
+    for (i = 0; i < n; i++){
+      if (results[i] != 0){
+	candidates[m++] = words[i];
+      }
+    }
+  } else {
+    for (i = 0; i < n; i++){
+      candidates[m++] = words[i];
+    }
+  }
+  if (job->a != NULL){
+    art_search_batch(job->a, candidates, m, found);
+  } else if (job->t != NULL){
+    tree_search_batch(job->t, candidates, m, found);
+  } else if (job->perfect != NULL){
+    mphf_search_batch(job->perfect, candidates, m, found);
+  } else {
+    htable_search_batch(job->h, candidates, m, found);
+  }
+  for (i = 0, m = 0; i < n; i++){
+    if (job->filter == NULL || results[i] != 0){
+      results[i] = found[m++];
+      false_hits += results[i] == 0;
+    }
+  }
+  return false_hits;
+}
+
+/**
+ * Function: serve_words
+ * Purpose: looks words up for the server.
+ *
+ * @param dict the check_job holding the dictionary.
+ * @param words the words.
+ * @param n the number of words.
+ * @param results set to the frequency of each word, 0 for an unknown word.
+ */
+static void serve_words(void *dict, char **words, int n, int *results) {
+  lookup_words(dict, words, n, results);
+}
+
+/**
+ * Function: check_words
+ * Purpose: checks the words of one file against the dictionary, a
+ * batch at a time.
+ *
+ * @param job the dictionary.
+ * @param file the file to check.
+ */
+static void check_words(struct check_job *job, struct check_file *file) {
+  char batch[CHECK_BATCH][256];
+  char *words[CHECK_BATCH];
+  int results[CHECK_BATCH];
+  double start = wall_time();
+  FILE *infile = fopen(file->name, "r");
+  tokenizer check;
+  char *word;
+  int i, n, len;
+
+  if (infile == NULL){
+    file->missing = TRUE;
+    return;
+  }
+  check = tokenizer_new(infile);
+  for (i = 0; i < CHECK_BATCH; i++){
+    words[i] = batch[i];
+  }
+  do {
+    n = 0;
+    while (n < CHECK_BATCH && (len = tokenizer_next(check, &word)) != EOF){
+      memcpy(batch[n++], word, len + 1);
+    }
+    file->false_hits += lookup_words(job, words, n, results);
+
+    for (i = 0; i < n; i++){
+      if (results[i] == 0){
+	if (job->prefix == TRUE){
+	  check_append(file, file->name, strlen(file->name));
+	  check_append(file, ":", 1);
+	}
+	check_append(file, batch[i], strlen(batch[i]));
+	check_append(file, "\n", 1);
+	file->unknown++;
+      }
+    }
+  } while (n == CHECK_BATCH);
+
+  tokenizer_free(check);
+  fclose(infile);
+  file->time = wall_time() - start;
+}
+
+/**
+ * Function: check_worker
+ * Purpose: the body of a check worker thread, which checks the next
+ * file nobody has taken until there are none left, and signals as each
+ * one is done.
+ *
+ * @param arg the check job.
+ * @return NULL.
+ */
+static void *check_worker(void *arg) {
+  struct check_job *job = arg;
+  int i;
+
+  for (;;){
+    pthread_mutex_lock(&job->lock);
+    i = job->next++;
+    pthread_mutex_unlock(&job->lock);
+    if (i >= job->num_files){
+      return NULL;
+    }
+    check_words(job, &job->files[i]);
+    pthread_mutex_lock(&job->lock);
+    job->files[i].done = TRUE;
+    pthread_cond_broadcast(&job->checked);
+    pthread_mutex_unlock(&job->lock);
+  }
+}
+
+/**
+ * Function: compare_names
+ * Purpose: orders file names for qsort.
+ *
+ * @param a a pointer to the first name.
+ * @param b a pointer to the second name.
+ * @return less than, equal to or greater than 0 as the first name sorts
+ * before, with or after the second.
+ */
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/**
+ * Function: add_check_files
+ * Purpose: adds a file to the list to check with -c, or every file
+ * under a directory, in sorted order. Names starting with a dot are
+ * skipped inside directories.
+ *
+ * @param files the list, which grows as needed.
+ * @param n the number of files in the list, updated.
+ * @param size the room in the list, updated.
+ * @param path the file or directory.
+ */
+static void add_check_files(struct check_file **files, int *n, int *size,
+			    const char *path) {
+  struct stat st;
+  struct dirent *entry;
+  DIR *dir;
+  char **names = NULL;
+  int i, num_names = 0, max_names = 0;
+
+  if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)
+      && (dir = opendir(path)) != NULL){
+    while ((entry = readdir(dir)) != NULL){
+      if (entry->d_name[0] == '.'){
+	continue;
+      }
+      if (num_names == max_names){
+	max_names = max_names == 0 ? 16 : 2 * max_names;
+	names = erealloc(names, max_names * sizeof names[0]);
+      }
+      names[num_names] = emalloc(strlen(path) + strlen(entry->d_name) + 2);
+      sprintf(names[num_names++], "%s/%s", path, entry->d_name);
+    }
+    closedir(dir);
+    qsort(names, num_names, sizeof names[0], compare_names);
+    for (i = 0; i < num_names; i++){
+      add_check_files(files, n, size, names[i]);
+      free(names[i]);
+    }
+    free(names);
+    return;
+  }
+  if (*n == *size){
+    *size = *size == 0 ? 16 : 2 * *size;
+    *files = erealloc(*files, *size * sizeof (*files)[0]);
+  }
+  (*files)[*n].name = emalloc(strlen(path) + 1);
+  strcpy((*files)[*n].name, path);
+  (*files)[*n].text = NULL;
+  (*files)[*n].len = 0;
+  (*files)[*n].size = 0;
+  (*files)[*n].unknown = 0;
+  (*files)[*n].false_hits = 0;
+  (*files)[*n].missing = FALSE;
+  (*files)[*n].done = FALSE;
+  (*files)[*n].time = 0.0;
+  (*n)++;
 }
 
 /**
@@ -41,14 +641,26 @@ static void print_help(){
   
   printf("-T           Use a tree data structure (deafult is ");
   printf("hash table)\n");
+  printf("-A           Use an adaptive radix tree, printed in ");
+  printf("sorted order\n");
   printf("-c FILENAME  Check the spelling of words in FILENAME");
   printf(" using the words\n");
   printf("             read from stdin as dictionary. Print ");
   printf("unknown words to\n");
   printf("             stdout, timing info etc to stderr ");
-  printf("(ignore -o & -p)\n");
+  printf("(ignore -o & -p).\n");
+  printf("             Files after the options, and files in ");
+  printf("directories, are\n");
+  printf("             checked too, each unknown word then ");
+  printf("prefixed by its file\n");
+  printf("-j JOBS      Check the files given to -c using JOBS ");
+  printf("threads\n");
   printf("-d           Use double hashing (linear probing is ");
   printf("the default)\n");
+  printf("-g           Use SIMD group probing over control ");
+  printf("bytes instead\n");
+  printf("-H HASH      Hash words with java (the default), ");
+  printf("word or xx\n");
   printf("-e           Display the entire contents of hash ");
   printf("table to stderr\n");
   printf("-o           Output the tree in DOT form to  file ");
@@ -57,10 +669,49 @@ static void print_help(){
   printf("frequencies & words\n");
   printf("-r           Makes the tree an RBT (the default ");
   printf("is a BST)\n");
+  printf("-B           Makes the tree a B-tree (the default ");
+  printf("is a BST)\n");
   printf("-s SNAPSHOTS Show SNAPSHOTS stats snapshots (if ");
   printf("-p is used)\n");
   printf("-t TABLESIZE Use the first prime >= TABLESIZE as ");
-  printf("htable size.\n\n");
+  printf("htable size.\n");
+  printf("-l LOAD      Grow the hash table once more than LOAD ");
+  printf("of it is used\n");
+  printf("             (default 0.75)\n");
+  printf("-P THREADS   Fill the hash table from stdin using ");
+  printf("THREADS threads\n");
+  printf("-S           With -P, count words in a table per ");
+  printf("thread and merge\n");
+  printf("             them at the end (needed for trees)\n");
+  printf("-k N         Print the N most frequent words ");
+  printf("instead of every word\n");
+  printf("-K N         Print about the N most frequent words ");
+  printf("from stdin in\n");
+  printf("             bounded memory, without building the ");
+  printf("data structure\n");
+  printf("-R FILE      Remove the words in FILE from the ");
+  printf("dictionary once filled\n");
+  printf("-W FILE      Save the hash table, or the tree ready ");
+  printf("for -c, to FILE\n");
+  printf("-L FILE      Use the hash table or tree (with -T) saved ");
+  printf("in FILE instead\n");
+  printf("             of reading a dictionary from stdin\n");
+  printf("-V           With -L, check the whole file against its ");
+  printf("checksum first\n");
+  printf("-F           With -c or -U, rule out unknown words with a ");
+  printf("Bloom filter\n");
+  printf("             before searching for them\n");
+  printf("-M           With -c or -U, search a minimal perfect hash ");
+  printf("table built from\n");
+  printf("             the hash table\n");
+  printf("-U SOCKET    Serve lookups in the dictionary on the Unix ");
+  printf("socket SOCKET\n");
+  printf("             until interrupted: each line sent holds a ");
+  printf("word, and each\n");
+  printf("             line sent back its frequency, or 0 ");
+  printf("if unknown\n");
+  printf("-C SOCKET    Look the words from stdin up through the ");
+  printf("server on SOCKET\n");
   printf("-h           Display this message\n\n");
     
            
@@ -110,34 +761,101 @@ static int find_next_prime(int a){
   return i;
 }
 
+/**
+ * Function: clean_up
+ * Purpose: frees whatever main has made by the time it stops, whether
+ * it has finished or given up part way, along with the reader and the
+ * writers, flushing anything still waiting to be written.
+ *
+ * @param status the exit status main is stopping with.
+ * @param input the reader of stdin.
+ * @param a the radix tree, or NULL.
+ * @param t the tree, or NULL.
+ * @param h the hash table, or NULL.
+ * @param perfect the minimal perfect hash table, or NULL.
+ * @return status.
+ */
+static int clean_up(int status, tokenizer input, art a, tree t, htable h,
+		    mphf perfect){
+  if (a != NULL){
+    art_free(a);
+  }
+  if (t != NULL){
+    tree_free(t);
+  }
+  if (perfect != NULL){
+    mphf_free(perfect);
+  }
+  if (h != NULL){
+    htable_free(h);
+  }
+  if (filter != NULL){
+    bloom_free(filter);
+  }
+  tokenizer_free(input);
+  output_free(out);
+  output_free(err);
+  return status;
+}
+
 /**
  * Main method. Takes options given through the command line. Reads words into
  * a selected data structure before giving output depending on options given.
  */ 
 int main(int argc, char **argv){
 
-  const char *optstring = "Tc:deoprs:t:h";
+  const char *optstring = "TAc:degoprBs:t:l:H:P:Sk:K:R:W:L:VFMj:U:C:h";
   char option;
-  char word[256];
-  char *filename;
+  char *word;
+  struct check_job job;
+  struct check_file *files;
+  int num_files, max_files, workers = 1, false_hits = 0;
+  int status = EXIT_SUCCESS;
+  pthread_t *ids;
+  char *filename = NULL;
+  char *save_file = NULL;
+  char *load_file = NULL;
+  char *remove_file = NULL;
+  char *socket_path = NULL;
 
-  tree t;
-  htable h;
-  int tablesize, snapshots, found, unknown;
-  FILE *infile;
-  FILE *outfile;
-  clock_t start, end;
+  tree t = NULL;
+  art a = NULL;
+  htable h = NULL, counts;
+  struct key_stream stream;
+  mphf perfect = NULL;
+  char *key, **keys;
+  int *freqs;
+  int tablesize = 0, snapshots = 10, unknown, i, n, threads = 1, top = 0;
+  double max_load = 0.75;
+  hash_t hash = JAVA_H;
+  tokenizer input, removals;
+  FILE *infile, *outfile;
+  double start, end;
   double fill_time = 0.0, search_time = 0.0;
 
   int flag_T = FALSE;
+  int flag_A = FALSE;
   int flag_c = FALSE;
   int flag_d = FALSE;
   int flag_e = FALSE;
+  int flag_g = FALSE;
   int flag_o = FALSE;
   int flag_p = FALSE;
   int flag_r = FALSE;
+  int flag_B = FALSE;
   int flag_s = FALSE;
+  int flag_S = FALSE;
   int flag_t = FALSE;
+  int flag_k = FALSE;
+  int flag_K = FALSE;
+  int flag_R = FALSE;
+  int flag_W = FALSE;
+  int flag_L = FALSE;
+  int flag_V = FALSE;
+  int flag_F = FALSE;
+  int flag_M = FALSE;
+  int flag_U = FALSE;
+  int flag_C = FALSE;
     
 
     
@@ -147,6 +865,11 @@ int main(int argc, char **argv){
       /* Use a tree data structure (default is hashtable) */
       flag_T = TRUE;
       break;
+    case 'A':
+      /* Use an adaptive radix tree instead, which takes the place
+	 of -T if both are given. */
+      flag_A = TRUE;
+      break;
     case 'c':
       /* Check the spelling of words in filename using words read
 	 from stdin as the dictionary. Print all unknown words to
@@ -167,6 +890,12 @@ int main(int argc, char **argv){
 	 index, frequency, stats and the key if it exists. */
       flag_e = TRUE;
       break;
+    case 'g':
+      /* Use group probing, which keeps 7 bits of each hash in a
+	 control byte and checks 16 slots at a time, as the
+	 collision resolution strategy. */
+      flag_g = TRUE;
+      break;
     case 'o':
       /* Output a representation of the tree in 'dot' form to the
 	 file 'tree-view.dot' using the functions given in
@@ -183,6 +912,10 @@ int main(int argc, char **argv){
       /* Make the tree an rbt instead of the default bst. */
       flag_r = TRUE;
       break;
+    case 'B':
+      /* Make the tree a b-tree instead of the default bst. */
+      flag_B = TRUE;
+      break;
     case 's':
       /* Display up to the given number of stats snapchots when
 	 given -p as an argument. If the table is not full then
@@ -198,6 +931,118 @@ int main(int argc, char **argv){
       flag_t = TRUE;
       tablesize = atoi(optarg);
       break;
+    case 'l':
+      /* Grow the hash table to the next prime at least twice its
+	 size once inserting a new word would take it past this
+	 fraction of its capacity. */
+      max_load = atof(optarg);
+      if (max_load <= 0.0 || max_load > 1.0){
+	print_help();
+      }
+      break;
+    case 'H':
+      /* Hash words with the 31 * h + c java string hash, a word at a
+	 time hash or an xxHash style hash. */
+      if (strcmp(optarg, "java") == 0){
+	hash = JAVA_H;
+      } else if (strcmp(optarg, "word") == 0){
+	hash = WORD_H;
+      } else if (strcmp(optarg, "xx") == 0){
+	hash = XX_H;
+      } else {
+	print_help();
+      }
+      break;
+    case 'P':
+      /* Fill the hash table using this many threads, all inserting
+	 into the same table. */
+      threads = atoi(optarg);
+      if (threads < 1){
+	print_help();
+      }
+      break;
+    case 'k':
+      /* Print only the given number of most frequent words, picked
+	 from the counts in the data structure once it is filled. */
+      flag_k = TRUE;
+      top = atoi(optarg);
+      if (top < 1){
+	print_help();
+      }
+      break;
+    case 'K':
+      /* Count the given number of most frequent words as they are
+	 read, keeping no more words than that. Counts are never too
+	 low but can be too high for the least frequent words. */
+      flag_K = TRUE;
+      top = atoi(optarg);
+      if (top < 1){
+	print_help();
+      }
+      break;
+    case 'S':
+      /* With -P, give each thread a private table for its share of
+	 the input and merge them once every thread is done. The
+	 result matches filling from a single thread. */
+      flag_S = TRUE;
+      break;
+    case 'R':
+      /* Take the words listed in this file back out of the
+	 dictionary once it is filled, whatever their frequency. */
+      flag_R = TRUE;
+      remove_file = optarg;
+      break;
+    case 'W':
+      /* Save the finished hash table, or the tree frozen for
+	 searching, to a file which -L can load. */
+      flag_W = TRUE;
+      save_file = optarg;
+      break;
+    case 'L':
+      /* Map in a dictionary saved with -W instead of reading one
+	 from stdin. A tree has to be loaded with -T, and can only
+	 be used to check words with -c. */
+      flag_L = TRUE;
+      load_file = optarg;
+      break;
+    case 'V':
+      /* With -L, read the whole file to check it against its checksum
+	 before using it, instead of only its header. */
+      flag_V = TRUE;
+      break;
+    case 'F':
+      /* With -c or -U, check each word against a Bloom filter of the
+	 dictionary first, so most unknown words are never looked
+	 up at all. */
+      flag_F = TRUE;
+      break;
+    case 'M':
+      /* With -c or -U, turn the finished hash table into a minimal
+	 perfect hash table, which finds any word with one probe,
+	 and check the words against that. */
+      flag_M = TRUE;
+      break;
+    case 'j':
+      /* Check the files given to -c using this many threads, all
+	 searching the same dictionary. */
+      workers = atoi(optarg);
+      if (workers < 1){
+	print_help();
+      }
+      break;
+    case 'U':
+      /* Instead of printing the dictionary or checking files, serve
+	 lookups in it over a Unix domain socket at this path until
+	 stopped with SIGINT or SIGTERM. */
+      flag_U = TRUE;
+      socket_path = optarg;
+      break;
+    case 'C':
+      /* Look the words read from stdin up through a server started
+	 with -U on this socket, printing their frequencies. */
+      flag_C = TRUE;
+      socket_path = optarg;
+      break;
     case 'h':
       /* Print a help message describing how to use the program. */
       print_help();
@@ -209,9 +1054,69 @@ int main(int argc, char **argv){
     }
   }
 
-  /* Making either an rbt, bst or htable depending on input. */
-  if (flag_T == TRUE){
-    if (flag_r == TRUE){
+  if (flag_A == TRUE){
+    flag_T = FALSE;
+  }
+  if ((flag_W == TRUE || flag_L == TRUE) && flag_A == TRUE){
+    fprintf(stderr, "Error: -W and -L need a hash table or tree\n");
+    return EXIT_FAILURE;
+  }
+  if (flag_M == TRUE && (flag_T == TRUE || flag_A == TRUE)){
+    fprintf(stderr, "Error: -M needs a hash table\n");
+    return EXIT_FAILURE;
+  }
+  if (flag_F == TRUE && flag_L == TRUE && flag_T == TRUE){
+    fprintf(stderr, "Error: -F cannot be used with a saved tree\n");
+    return EXIT_FAILURE;
+  }
+  if (flag_L == TRUE && flag_T == TRUE && flag_c == FALSE
+      && flag_U == FALSE){
+    fprintf(stderr, "Error: a saved tree can only be used with -c or -U\n");
+    return EXIT_FAILURE;
+  }
+  if (flag_R == TRUE && (flag_A == TRUE || flag_L == TRUE)){
+    fprintf(stderr, "Error: -R needs a dictionary read from stdin\n");
+    return EXIT_FAILURE;
+  }
+  if (flag_U == TRUE && flag_c == TRUE){
+    fprintf(stderr, "Error: -c cannot be used with -U\n");
+    return EXIT_FAILURE;
+  }
+
+  input = tokenizer_new(stdin);
+  out = output_new(STDOUT_FILENO);
+  err = output_new(STDERR_FILENO);
+
+  /* Space-Saving needs no data structure holding every word. */
+  if (flag_K == TRUE){
+    top_words = topk_new(top);
+    while (tokenizer_next(input, &word) != EOF){
+      topk_add(top_words, word);
+    }
+    topk_print(top_words, print_info);
+    topk_free(top_words);
+    return clean_up(EXIT_SUCCESS, input, a, t, h, perfect);
+  }
+
+  /* The client leaves the dictionary to the server. */
+  if (flag_C == TRUE){
+    if (client_run(socket_path, input, print_info, err) != 0){
+      status = EXIT_FAILURE;
+    }
+    return clean_up(status, input, a, t, h, perfect);
+  }
+
+  /* Making either a radix tree, b-tree, rbt, bst or htable depending
+     on input, unless one saved before is to be mapped in. */
+  if (flag_L == TRUE){
+    t = NULL;
+    h = NULL;
+  } else if (flag_A == TRUE){
+    a = art_new();
+  } else if (flag_T == TRUE){
+    if (flag_B == TRUE){
+      t = tree_new(BTREE);
+    } else if (flag_r == TRUE){
       t = tree_new(RBT);
     } else {
       t = tree_new(BST);
@@ -222,78 +1127,278 @@ int main(int argc, char **argv){
     } else {
       tablesize = 113;
     }
-    if (flag_d == TRUE){
-      h = htable_new(tablesize, DOUBLE_H);
+    if (flag_g == TRUE){
+      h = htable_new(tablesize, SWISS_G, hash, max_load);
+    } else if (flag_d == TRUE){
+      h = htable_new(tablesize, DOUBLE_H, hash, max_load);
     } else {
-      h = htable_new(tablesize, LINEAR_P);
+      h = htable_new(tablesize, LINEAR_P, hash, max_load);
     }
   }
 
-  /* Filling data structure with words from stdin. */
-  start = clock();
-    
-  while (getword(word, sizeof word, stdin) != EOF){
+  /* Filling data structure with words from stdin, or loading it. */
+  start = wall_time();
+
+  if (flag_L == TRUE){
     if (flag_T == TRUE){
-      t = tree_insert(t, word);
+      t = tree_load(load_file, flag_V);
+    } else {
+      h = htable_load(load_file, flag_V);
+    }
+    if (t == NULL && h == NULL){
+      fprintf(stderr, "Error: cannot load %s\n", load_file);
+      return clean_up(EXIT_FAILURE, input, a, t, h, perfect);
+    }
+  } else if (threads > 1 && (flag_T == TRUE || flag_A == TRUE)){
+    if (flag_S == FALSE){
+      fprintf(stderr, "Error: -P needs -S when using a tree\n");
+      return clean_up(EXIT_FAILURE, input, a, t, h, perfect);
+    }
+    /* Keys go into the tree in the order first seen, so it has the
+       same shape as one filled a word at a time. */
+    counts = htable_new(113, LINEAR_P, XX_H, 0.75);
+    parallel_fill(counts, stdin, threads, TRUE);
+    if (flag_A == TRUE){
+      for (i = 0; i < htable_num_keys(counts); i++){
+        key = htable_key(counts, i, &n);
+        art_insert_freq(a, key, n);
+      }
+    } else {
+      stream.h = counts;
+      stream.next = 0;
+      fill_tree(t, &stream, next_key);
+    }
+    htable_free(counts);
+  } else if (threads > 1){
+    parallel_fill(h, stdin, threads, flag_S);
+  } else if (flag_T == TRUE){
+    fill_tree(t, input, next_word);
+  }
+    
+  while (threads == 1 && flag_T == FALSE && flag_L == FALSE
+         && tokenizer_next(input, &word) != EOF){
+    if (flag_A == TRUE){
+      art_insert(a, word);
     } else {
       htable_insert(h, word);
     }
   }
+
+  /* Words given to -R are taken out before the dictionary is used. */
+  if (flag_R == TRUE){
+    if ((infile = fopen(remove_file, "r")) == NULL){
+      fprintf(stderr, "Error: cannot open %s\n", remove_file);
+      return clean_up(EXIT_FAILURE, input, a, t, h, perfect);
+    }
+    removals = tokenizer_new(infile);
+    while (tokenizer_next(removals, &word) != EOF){
+      if (flag_T == TRUE){
+        tree_remove(t, word);
+      } else {
+        htable_remove(h, word);
+      }
+    }
+    tokenizer_free(removals);
+    fclose(infile);
+  }
+
+  /* The tree does not change while words are being checked, so its
+     keys can be laid out for faster searching. */
+  if (flag_T == TRUE && (flag_c == TRUE || flag_U == TRUE)
+      && flag_L == FALSE){
+    tree_freeze(t);
+  }
+
+  /* The dictionary does not change while words are being checked, so
+     the hash table can be rebuilt with one slot for each word. The
+     perfect hash points at the keys of the hash table, which are kept
+     until the end. */
+  if (flag_M == TRUE && (flag_c == TRUE || flag_U == TRUE)){
+    n = htable_num_keys(h);
+    keys = emalloc((n + 1) * sizeof keys[0]);
+    freqs = emalloc((n + 1) * sizeof freqs[0]);
+    for (i = 0; i < n; i++){
+      keys[i] = htable_key(h, i, &freqs[i]);
+    }
+    perfect = mphf_new(keys, freqs, n);
+    free(keys);
+    free(freqs);
+  }
+
+  /* The filter is sized for the words in the dictionary, so it is
+     built once they are all in. */
+  if (flag_F == TRUE && (flag_c == TRUE || flag_U == TRUE)){
+    filter_words = 0;
+    if (flag_A == TRUE){
+      art_inorder(a, count_filter_word);
+    } else if (flag_T == TRUE){
+      tree_inorder(t, count_filter_word);
+    } else {
+      filter_words = htable_num_keys(h);
+    }
+    filter = bloom_new(filter_words, BLOOM_BITS);
+    if (flag_A == TRUE){
+      art_inorder(a, add_filter_word);
+    } else if (flag_T == TRUE){
+      tree_inorder(t, add_filter_word);
+    } else {
+      htable_print(h, add_filter_word);
+    }
+  }
     
-  end = clock();
-  fill_time = (end - start) / (double) CLOCKS_PER_SEC;
+  end = wall_time();
+  fill_time = end - start;
+
+  if (flag_W == TRUE
+      && (flag_T == TRUE ? tree_save(t, save_file)
+          : htable_save(h, save_file)) != 0){
+    fprintf(stderr, "Error: cannot save %s\n", save_file);
+    return clean_up(EXIT_FAILURE, input, a, t, h, perfect);
+  }
 
   /* Check if e option was given and print table contents
      if necessary. */
-  if (flag_e == TRUE && flag_T == FALSE){
-    htable_print_entire_table(h, stderr);
+  if (flag_e == TRUE && flag_T == FALSE && flag_A == FALSE){
+    htable_print_entire_table(h, err);
+  }
+
+  /* Once the perfect hash is searched instead, and the hash table has
+     been saved or printed if asked, only its keys are still needed. */
+  if (perfect != NULL){
+    htable_release_slots(h);
   }
 
-  /* Performs comparison to file if c option was given. */
-  if (flag_c == TRUE){
+  /* Answers lookups until stopped if U option was given. The
+     dictionary is searched the same way as when checking files. */
+  if (flag_U == TRUE){
+    job.a = flag_A == TRUE ? a : NULL;
+    job.t = flag_T == TRUE ? t : NULL;
+    job.perfect = flag_M == TRUE ? perfect : NULL;
+    job.h = h;
+    job.filter = flag_F == TRUE ? filter : NULL;
+    output_printf(err, "Fill time     : %f\n", fill_time);
+    output_flush(err);
+    if (server_run(socket_path, serve_words, &job, err) != 0){
+      status = EXIT_FAILURE;
+    }
+    if (flag_F == TRUE){
+      output_printf(err, "Bloom filter  : %lu bytes\n",
+		    (unsigned long) bloom_size(filter));
+    }
+    if (flag_M == TRUE){
+      output_printf(err, "Perfect hash  : %lu bytes for %d words, and "
+		    "%lu bytes of keys kept from the hash table\n",
+		    (unsigned long) mphf_size(perfect), htable_num_keys(h),
+		    (unsigned long) mphf_key_bytes(perfect));
+    }
+
+    /* Performs comparison to the files if c option was given. Each
+       worker checks a whole file at a time, and the files are printed
+       in the order given as soon as each one is done. */
+  } else if (flag_c == TRUE){
+    files = NULL;
+    num_files = 0;
+    max_files = 0;
+    add_check_files(&files, &num_files, &max_files, filename);
+    for (i = optind; i < argc; i++){
+      add_check_files(&files, &num_files, &max_files, argv[i]);
+    }
+    job.a = flag_A == TRUE ? a : NULL;
+    job.t = flag_T == TRUE ? t : NULL;
+    job.perfect = flag_M == TRUE ? perfect : NULL;
+    job.h = h;
+    job.filter = flag_F == TRUE ? filter : NULL;
+    job.prefix = num_files > 1;
+    job.files = files;
+    job.num_files = num_files;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.checked, NULL);
+    if (workers > num_files){
+      workers = num_files;
+    }
+    ids = emalloc(workers * sizeof ids[0]);
     unknown = 0;
-    infile = fopen(filename, "r");
-       
-    if (infile == NULL){ 
-      fprintf(stderr, "Error: no file specified");
-      return EXIT_FAILURE;
+    start = wall_time();
+
+    for (i = 0; i < workers; i++){
+      pthread_create(&ids[i], NULL, check_worker, &job);
     }
-        
-    start = clock();
-        
-    while (getword(word, sizeof word, infile) != EOF){
-      if (flag_T == TRUE){
-	found = tree_search(t, word);
-      } else {
-	found = htable_search(h, word);
+    for (i = 0; i < num_files; i++){
+      pthread_mutex_lock(&job.lock);
+      while (files[i].done == FALSE){
+	pthread_cond_wait(&job.checked, &job.lock);
       }
-            
-      if (found == 0){
-	fprintf(stdout, "%s\n", word);
-	unknown++;
+      pthread_mutex_unlock(&job.lock);
+      if (files[i].missing == TRUE){
+	output_puts(err, "Error: cannot open ");
+	output_puts(err, files[i].name);
+	output_putc(err, '\n');
+	status = EXIT_FAILURE;
+      } else if (num_files > 1){
+	output_puts(err, files[i].name);
+	output_printf(err, ": %d unknown words, %f seconds\n",
+		      files[i].unknown, files[i].time);
       }
+      output_write(out, files[i].text, files[i].len);
+      unknown += files[i].unknown;
+      false_hits += files[i].false_hits;
+      free(files[i].text);
+      free(files[i].name);
+    }
+    for (i = 0; i < workers; i++){
+      pthread_join(ids[i], NULL);
     }
         
-    end = clock();
-    search_time = (end - start) / (double) CLOCKS_PER_SEC;
-    fclose(infile);
+    end = wall_time();
+    search_time = end - start;
+    pthread_cond_destroy(&job.checked);
+    pthread_mutex_destroy(&job.lock);
+    free(ids);
+    free(files);
         
-    fprintf(stderr, "Fill time     : %f\n", fill_time);
-    fprintf(stderr, "Search time   : %f\n", search_time);
-    fprintf(stderr, "Unknown words = %d\n", unknown);
+    output_printf(err, "Fill time     : %f\n", fill_time);
+    output_printf(err, "Search time   : %f\n", search_time);
+    output_printf(err, "Unknown words = %d\n", unknown);
+    if (flag_F == TRUE){
+      output_printf(err, "Bloom filter  : %lu bytes, %d false positives "
+		    "in %d unknown words (%.2f%%)\n",
+		    (unsigned long) bloom_size(filter), false_hits, unknown,
+		    unknown > 0 ? 100.0 * false_hits / unknown : 0.0);
+    }
+    if (flag_M == TRUE){
+      output_printf(err, "Perfect hash  : %lu bytes for %d words, and "
+		    "%lu bytes of keys kept from the hash table\n",
+		    (unsigned long) mphf_size(perfect), htable_num_keys(h),
+		    (unsigned long) mphf_key_bytes(perfect));
+    }
 
     /* Print stats if p option was given, and data structure
        is a hash table, and c option was not given. Otherwise
        print data strucutre info as default. */
-  } else if (flag_p == TRUE && flag_T == FALSE && flag_c == FALSE){
+  } else if (flag_k == TRUE){
+    top_words = topk_new(top);
+    if (flag_A == TRUE){
+      art_inorder(a, add_top_word);
+    } else if (flag_T == TRUE){
+      tree_inorder(t, add_top_word);
+    } else {
+      htable_print(h, add_top_word);
+    }
+    topk_print(top_words, print_info);
+    topk_free(top_words);
+  } else if (flag_p == TRUE && flag_T == FALSE && flag_A == FALSE
+             && flag_c == FALSE){
         
     if (flag_s == TRUE){
-      htable_print_stats(h, stdout, snapshots);
+      htable_print_stats(h, out, snapshots);
     } else {
-      htable_print_stats(h, stdout, 10);
+      htable_print_stats(h, out, 10);
     }
   } else {
-    if (flag_T == TRUE){
+    if (flag_A == TRUE){
+      art_inorder(a, print_info);
+    } else if (flag_T == TRUE){
       tree_preorder(t, print_info);
     } else {
       htable_print(h, print_info);
@@ -302,20 +1407,14 @@ int main(int argc, char **argv){
 
   /* Create dot output file if o option was given, and data
      structure is a tree, and c option was not given. */
-  if (flag_o == TRUE && flag_T == TRUE && flag_c == FALSE){
-    printf("Creating dot file 'tree-view.dot'\n");
+  if (flag_o == TRUE && flag_T == TRUE && flag_c == FALSE
+      && flag_U == FALSE){
+    output_puts(out, "Creating dot file 'tree-view.dot'\n");
     outfile = fopen("tree-view.dot", "w");
     tree_output_dot(t, outfile);
     fclose(outfile);
   }
 
   /* Free the data structure being used. */
-  if (flag_T == TRUE){
-    tree_free(t);
-  } else {
-    htable_free(h);
-  }
-    
-            
-  return EXIT_SUCCESS;     
+  return clean_up(status, input, a, t, h, perfect);
 }
@@ -0,0 +1,195 @@
+/**
+ * File: bloom.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mylib.h"
+#include "bloom.h"
+
+/* Each block is one cache line of eight 64 bit words, and a word sets
+   one bit in each of them. */
+#define BLOCK_WORDS 8
+#define BLOCK_BYTES (BLOCK_WORDS * 8)
+#define BATCH_SIZE 16
+
+/* Odd multipliers which pick a different bit of each word of a block
+   from the same 32 bits of hash. */
+static const uint32_t salts[BLOCK_WORDS] = {
+  0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+  0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+/**
+ * Struct: bloomrec
+ * Purpose: declares the variables for a blocked Bloom filter. A word
+ * only ever touches the one block its hash picks, so a lookup costs a
+ * single cache miss however many bits are checked. The blocks start
+ * on a cache line boundary inside memory, which is allocated a line
+ * larger than they need.
+ */
+struct bloomrec {
+  uint64_t *blocks;
+  unsigned int num_blocks;
+  void *memory;
+};
+
+/**
+ * Function: bloom_new
+ * Purpose: creates an empty filter sized for a number of words.
+ *
+ * @param n the number of words which will be added.
+ * @param bits_per_key the number of bits to allow for each word. Ten
+ * gives about one false positive in a hundred.
+ * @return the new filter.
+ */
+bloom bloom_new(int n, int bits_per_key){
+  bloom b = emalloc(sizeof *b);
+  size_t bits = (size_t) (n > 0 ? n : 1) * bits_per_key;
+  size_t bytes;
+
+  b->num_blocks = (unsigned int) ((bits + BLOCK_BYTES * 8 - 1)
+                                  / (BLOCK_BYTES * 8));
+  bytes = (size_t) b->num_blocks * BLOCK_BYTES;
+  b->memory = emalloc(bytes + BLOCK_BYTES);
+  b->blocks = (uint64_t *) (((size_t) b->memory + BLOCK_BYTES - 1)
+                            / BLOCK_BYTES * BLOCK_BYTES);
+  memset(b->blocks, 0, bytes);
+  return b;
+}
+
+/**
+ * Function: bloom_hash
+ * Purpose: hashes a word for the filter.
+ *
+ * @param word the word.
+ * @return the hash of the word.
+ */
+static uint64_t bloom_hash(const char *word){
+  return hash_xx64(word, strlen(word), UINT64_C(0x9E3779B97F4A7C15));
+}
+
+/**
+ * Function: bloom_block
+ * Purpose: finds the block a hash belongs to, from its top 32 bits.
+ *
+ * @param b the filter.
+ * @param hash the hash of a word.
+ * @return the first word of the block.
+ */
+static uint64_t *bloom_block(bloom b, uint64_t hash){
+  return b->blocks
+    + (((hash >> 32) * b->num_blocks) >> 32) * BLOCK_WORDS;
+}
+
+/**
+ * Function: bloom_bit
+ * Purpose: works out the bit a hash sets in one word of its block, from
+ * the top 6 bits of its low 32 bits times the salt of that word.
+ *
+ * @param hash the hash of a word.
+ * @param i the word of the block.
+ * @return the bit, as a mask.
+ */
+static uint64_t bloom_bit(uint64_t hash, int i){
+  return (uint64_t) 1 << (((uint32_t) hash * salts[i]) >> 26);
+}
+
+/**
+ * Function: bloom_add
+ * Purpose: adds a word to the filter.
+ *
+ * @param b the filter.
+ * @param word the word.
+ */
+void bloom_add(bloom b, const char *word){
+  uint64_t hash = bloom_hash(word);
+  uint64_t *block = bloom_block(b, hash);
+  int i;
+
+  for (i = 0; i < BLOCK_WORDS; i++){
+    block[i] |= bloom_bit(hash, i);
+  }
+}
+
+/**
+ * Function: bloom_test
+ * Purpose: checks the bits of a hash in its block.
+ *
+ * @param block the block of the hash.
+ * @param hash the hash of a word.
+ * @return 1 if every bit is set, otherwise 0.
+ */
+static int bloom_test(const uint64_t *block, uint64_t hash){
+  uint64_t missing = 0;
+  int i;
+
+  for (i = 0; i < BLOCK_WORDS; i++){
+    missing |= bloom_bit(hash, i) & ~block[i];
+  }
+  return missing == 0;
+}
+
+/**
+ * Function: bloom_contains
+ * Purpose: checks whether a word may have been added to the filter.
+ *
+ * @param b the filter.
+ * @param word the word.
+ * @return 0 if the word was surely never added, or 1 if it may have been.
+ */
+int bloom_contains(bloom b, const char *word){
+  uint64_t hash = bloom_hash(word);
+
+  return bloom_test(bloom_block(b, hash), hash);
+}
+
+/**
+ * Function: bloom_contains_batch
+ * Purpose: checks many words against the filter at once. The words are
+ * hashed, and their blocks prefetched, a batch at a time before any is
+ * checked, so the cache misses of the batch overlap.
+ *
+ * @param b the filter.
+ * @param words the words.
+ * @param n the number of words.
+ * @param results set to the result bloom_contains gives for each word.
+ */
+void bloom_contains_batch(bloom b, char **words, int n, int *results){
+  uint64_t hashes[BATCH_SIZE];
+  int i, j, m;
+
+  for (i = 0; i < n; i += BATCH_SIZE){
+    m = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+    for (j = 0; j < m; j++){
+      hashes[j] = bloom_hash(words[i + j]);
+      PREFETCH(bloom_block(b, hashes[j]));
+    }
+    for (j = 0; j < m; j++){
+      results[i + j] = bloom_test(bloom_block(b, hashes[j]), hashes[j]);
+    }
+  }
+}
+
+/**
+ * Function: bloom_size
+ * Purpose: gives the memory the bits of the filter take up.
+ *
+ * @param b the filter.
+ * @return the size of the filter in bytes.
+ */
+size_t bloom_size(bloom b){
+  return (size_t) b->num_blocks * BLOCK_BYTES;
+}
+
+/**
+ * Function: bloom_free
+ * Purpose: frees all the memory allocated to the filter.
+ *
+ * @param b the filter.
+ */
+void bloom_free(bloom b){
+  free(b->memory);
+  free(b);
+}
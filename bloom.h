@@ -0,0 +1,30 @@
+/**
+ * File: bloom.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef BLOOM_H_
+#define BLOOM_H_
+
+#include <stddef.h>
+
+/**
+ * Struct: bloomrec
+ * Purpose: defines a struct type of bloomrec for a blocked Bloom filter,
+ * which answers whether a word may be in a set or is surely not.
+ */
+typedef struct bloomrec *bloom;
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the bloom.c file,
+ * based on their signatures.
+ */
+extern void bloom_add(bloom b, const char *word);
+extern int bloom_contains(bloom b, const char *word);
+extern void bloom_contains_batch(bloom b, char **words, int n, int *results);
+extern void bloom_free(bloom b);
+extern bloom bloom_new(int n, int bits_per_key);
+extern size_t bloom_size(bloom b);
+
+#endif
@@ -3,51 +3,183 @@
  * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "mylib.h"
+#include "snapshot.h"
 #include "htable.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_SIZE 16
+#define BATCH_SIZE 16
+#define CTRL_EMPTY 0x80
+
+#define CTRL_DELETED 0xfe
+
+/* The control byte of a slot claimed by a concurrent insert under group
+   probing whose tag is not yet published. */
+#define CTRL_CLAIMED 0xff
+
+/* Marks a slot claimed by a concurrent insert whose key is not yet
+   published. */
+#define CLAIMED (&claimed_key)
+
+/* Marks a slot whose key was removed under double hashing or group
+   probing. It reads as an empty string, so it never matches a word. */
+#define TOMBSTONE (&tombstone_key)
+
+#define IS_KEY(k) ((k) != NULL && (k) != TOMBSTONE)
+
+static char claimed_key;
+static char tombstone_key;
+
+/**
+ * Struct: htable_image
+ * Purpose: declares the header of a saved htable, giving its shape and
+ * the offsets of its arrays from the start of the file. A key offset of
+ * 0 is an empty slot and 1 a removed key; the strings start with two
+ * empty strings so neither is the offset of a key.
+ */
+struct htable_image {
+  int32_t capacity;
+  int32_t num_keys;
+  int32_t method;
+  int32_t hash;
+  uint64_t frequencies;
+  uint64_t hashes;
+  uint64_t ctrl;
+  uint64_t stats;
+  uint64_t order;
+  uint64_t ranks;
+  uint64_t keys;
+  uint64_t strings;
+  uint64_t strings_len;
+};
+
+/* Names a saved htable, and the version of its layout. */
+#define HTABLE_MAGIC "asgnHT02"
+
 /**
  * Struct: htablerec
- * Purpose: declares the variables for the htable.
+ * Purpose: declares the variables for the htable. An htable loaded from
+ * a file has its arrays where they lie in the mapped image, and its keys
+ * are found by their offsets into a block of strings instead of keys.
  */
 struct htablerec {
   int capacity;
   int num_keys;
+  int num_ranks;
+  int num_deleted;
   int *frequencies;
+  unsigned int *hashes;
+  unsigned char *ctrl;
   char **keys;
   int *stats;
+  int *order;
+  int *ranks;
+  arena key_arena;
+  uint64_t *key_offsets;
+  char *key_base;
+  void *image;
+  size_t image_len;
+  double max_load;
   hashing_t method;
+  hash_t hash;
+  pthread_rwlock_t resize_lock;
+  pthread_mutex_t arena_lock;
 };
 
+/**
+ * Function: next_prime
+ * Purpose: finds the first prime number greater than or equal to n.
+ *
+ * @param n the integer from which the search starts.
+ * @return the first prime >= n.
+ */
+static int next_prime(int n) {
+  int i, prime = 0;
+
+  if (n <= 2) {
+    return 2;
+  }
+  if (n % 2 == 0) {
+    n++;
+  }
+  while (!prime) {
+    prime = 1;
+    for (i = 3; i <= n / i; i += 2) {
+      if (n % i == 0) {
+        prime = 0;
+        n += 2;
+        break;
+      }
+    }
+  }
+  return n;
+}
+
 /**
  * Function: htable_new
  * Purpose: creates a new instance of htable.
  *
  * @param cap describes how many items the new htable holds.
- * @param method determines between linear probing or double hashing
- * as a collision resolution strategy.
+ * @param method determines between linear probing, double hashing or
+ * group probing as a collision resolution strategy. Group probing rounds
+ * the capacity up to a whole number of groups.
+ * @param hash the function used to hash the keys.
+ * @param max_load the fraction of the capacity which may be used before
+ * the htable grows to the next prime at least twice its size.
  * @return result the new htable created.
  */
-htable htable_new(int cap, hashing_t method) {
+htable htable_new(int cap, hashing_t method, hash_t hash, double max_load) {
   int i;
   htable result = emalloc(sizeof *result);
+
+  if (method == SWISS_G) {
+    cap = (cap + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+  }
   result->capacity = cap;
   result->num_keys = 0;
+  result->num_ranks = 0;
+  result->num_deleted = 0;
   result->method = method;
+  result->hash = hash;
+  result->max_load = max_load;
+  result->key_arena = arena_new();
+  result->key_offsets = NULL;
+  result->key_base = NULL;
+  result->image = NULL;
+  pthread_rwlock_init(&result->resize_lock, NULL);
+  pthread_mutex_init(&result->arena_lock, NULL);
   result->frequencies =
     emalloc(result->capacity * sizeof result->frequencies[0]);
+  result->hashes =
+    emalloc(result->capacity * sizeof result->hashes[0]);
+  result->ctrl = NULL;
+  if (method == SWISS_G) {
+    result->ctrl = emalloc(result->capacity * sizeof result->ctrl[0]);
+    memset(result->ctrl, CTRL_EMPTY, result->capacity);
+  }
   result->keys =
     emalloc(result->capacity * sizeof result->keys[0]);
   result->stats = emalloc(result->capacity * sizeof result->stats[0]);
-
+  result->order = emalloc(result->capacity * sizeof result->order[0]);
+  result->ranks = emalloc(result->capacity * sizeof result->ranks[0]);
 
   for (i = 0; i < result->capacity; i++) {
     result->frequencies[i] = 0;
+    result->hashes[i] = 0;
     result->keys[i] = NULL;
     result->stats[i] = 0;
+    result->order[i] = -1;
+    result->ranks[i] = -1;
   }
     
   return result;
@@ -60,24 +192,47 @@ htable htable_new(int cap, hashing_t method) {
  * @param h the hash table to be freed.
  */
 void htable_free(htable h) {
-  int i;
-
-  for (i = 0; i < h->capacity; i++) {
-    if (h->keys[i]){
-      free(h->keys[i]);
-    }
+  pthread_rwlock_destroy(&h->resize_lock);
+  pthread_mutex_destroy(&h->arena_lock);
+  if (h->image != NULL) {
+    snapshot_unload(h->image, h->image_len);
+    free(h);
+    return;
   }
-    
+  arena_free(h->key_arena);
   free(h->keys);
   free(h->frequencies);
+  free(h->hashes);
+  free(h->ctrl);
   free(h->stats);
+  free(h->order);
+  free(h->ranks);
   free(h);
 }
 
+/**
+ * Function: htable_slot_key
+ * Purpose: finds the key in a slot, whether the htable was built in
+ * memory or loaded from a file.
+ *
+ * @param h the htable.
+ * @param i the index of the slot.
+ * @return the key, NULL for an empty slot or TOMBSTONE for a removed key.
+ */
+static char *htable_slot_key(htable h, int i) {
+  uint64_t offset;
+
+  if (h->keys != NULL) {
+    return h->keys[i];
+  }
+  offset = h->key_offsets[i];
+  return offset == 0 ? NULL : offset == 1 ? TOMBSTONE : h->key_base + offset;
+}
+
 /**
  * Function: htable_word_to_int
  * Purpose: converts a word to an integer, to use as an index position
- * in htable_search.
+ * in htable_search. This is the 31 * h + c hash used by java strings.
  *
  * @param word char which is a pointer to word.
  * @return result the word converted to an unsigned int.
@@ -92,6 +247,79 @@ static unsigned int htable_word_to_int(char *word) {
   return result;
 }
 
+/**
+ * Function: htable_hash
+ * Purpose: hashes a word with the hash function chosen for the htable.
+ * The 64 bit hashes are folded down to 32 bits.
+ *
+ * @param h the htable the word is being hashed for.
+ * @param word the word to hash.
+ * @return the hash of the word.
+ */
+static unsigned int htable_hash(htable h, char *word) {
+  uint64_t result;
+
+  if (h->hash == JAVA_H) {
+    return htable_word_to_int(word);
+  } else if (h->hash == WORD_H) {
+    result = hash_word64(word, strlen(word));
+  } else {
+    result = hash_xx64(word, strlen(word), 0);
+  }
+  return (unsigned int) (result ^ (result >> 32));
+}
+
+/**
+ * Function: htable_home
+ * Purpose: maps a hash onto one of n positions. The mixed hashes use
+ * fastrange, a multiply and shift which takes the top bits of the hash.
+ * The low bits of htable_word_to_int are the best mixed, so it keeps
+ * using a modulo.
+ *
+ * @param h the htable the hash belongs to.
+ * @param hash the hash of a key.
+ * @param n the number of positions.
+ * @return a position from 0 to n - 1.
+ */
+static unsigned int htable_home(htable h, unsigned int hash, unsigned int n) {
+  if (h->hash == JAVA_H) {
+    return hash % n;
+  }
+  return (unsigned int) (((uint64_t) hash * n) >> 32);
+}
+
+/**
+ * Function: htable_home_slot
+ * Purpose: finds the first slot probed for a hash.
+ *
+ * @param h the htable the hash belongs to.
+ * @param hash the hash of a key.
+ * @return the index of the home slot, or of the first slot of the home
+ * group under group probing.
+ */
+static unsigned int htable_home_slot(htable h, unsigned int hash) {
+  if (h->method == SWISS_G) {
+    return htable_home(h, hash, h->capacity / GROUP_SIZE) * GROUP_SIZE;
+  }
+  return htable_home(h, hash, h->capacity);
+}
+
+/**
+ * Function: htable_hash_name
+ * Purpose: names the hash function of an htable for its printouts.
+ *
+ * @param h the htable.
+ * @return the name of its hash function.
+ */
+static const char *htable_hash_name(htable h) {
+  if (h->hash == JAVA_H) {
+    return "java";
+  } else if (h->hash == WORD_H) {
+    return "word";
+  }
+  return "xxhash";
+}
+
 /**
  * Function: htable_step
  * Purpose: Calculates the step to be applied to the hash key after
@@ -115,54 +343,636 @@ static unsigned int htable_step(htable h, unsigned int i_key) {
   exit(EXIT_FAILURE);
 }
 
+/**
+ * Function: htable_tag
+ * Purpose: works out the 7 bits of a hash kept in the control byte of the
+ * slot holding its key under group probing. The bits are taken from the
+ * top of a multiplicative mix, so they are independent of the home group.
+ *
+ * @param hash the hash of a key.
+ * @return the control byte for the key.
+ */
+static unsigned char htable_tag(unsigned int hash) {
+  return (unsigned char) (((hash * 2654435761u) & 0xffffffffu) >> 25);
+}
+
+/**
+ * Function: group_match
+ * Purpose: compares a control byte with each of the control bytes of a
+ * group, using a single SSE2 comparison where available.
+ *
+ * @param ctrl the first control byte of the group.
+ * @param byte the control byte to look for.
+ * @return a mask with bit i set if ctrl[i] equals byte.
+ */
+static unsigned int group_match(const unsigned char *ctrl,
+                                unsigned char byte) {
+#ifdef __SSE2__
+  __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group,
+                                          _mm_set1_epi8((char) byte)));
+#else
+  unsigned int mask = 0;
+  int i;
+
+  for (i = 0; i < GROUP_SIZE; i++) {
+    if (ctrl[i] == byte) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/**
+ * Function: lowest_bit
+ * Purpose: finds the position of the lowest set bit of a mask.
+ *
+ * @param mask a non-zero mask.
+ * @return the index of its lowest set bit.
+ */
+static int lowest_bit(unsigned int mask) {
+#ifdef __GNUC__
+  return __builtin_ctz(mask);
+#else
+  int i = 0;
+
+  while ((mask & 1) == 0) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/**
+ * Function: htable_probe_group
+ * Purpose: the group probing version of htable_probe. Whole groups of
+ * control bytes are checked at a time, and only slots whose control byte
+ * matches the tag of the hash have their stored hash and key compared.
+ * The search stops at the first group with an empty slot in it.
+ *
+ * @param h the htable to probe.
+ * @param str the word being looked for.
+ * @param hash the result of htable_hash for str.
+ * @param collisions set to the number of full groups passed over.
+ * @return the index of the slot found, or -1 if every group was probed.
+ */
+static int htable_probe_group(htable h, char *str, unsigned int hash,
+                              int *collisions) {
+  unsigned int groups = h->capacity / GROUP_SIZE;
+  unsigned int g = htable_home_slot(h, hash) / GROUP_SIZE;
+  unsigned char tag = htable_tag(hash);
+  unsigned char *ctrl;
+  unsigned int match;
+  int i;
+
+  for (*collisions = 0; *collisions < (int) groups; ++*collisions) {
+    ctrl = h->ctrl + g * GROUP_SIZE;
+    for (match = group_match(ctrl, tag); match != 0; match &= match - 1) {
+      i = g * GROUP_SIZE + lowest_bit(match);
+      if (h->hashes[i] == hash && strcmp(htable_slot_key(h, i), str) == 0) {
+        return i;
+      }
+    }
+    match = group_match(ctrl, CTRL_EMPTY);
+    if (match != 0) {
+      return g * GROUP_SIZE + lowest_bit(match);
+    }
+    g = (g + 1) % groups;
+  }
+  return -1;
+}
+
+/**
+ * Function: htable_probe
+ * Purpose: follows the probe sequence of a string until either the slot
+ * holding it or the first empty slot is found. The stored hash of each
+ * occupied slot is compared first, so a key is only read when the full
+ * hashes match.
+ *
+ * @param h the htable to probe.
+ * @param str the word being looked for.
+ * @param hash the result of htable_hash for str.
+ * @param collisions set to the number of occupied slots passed over.
+ * @return the index of the slot found, or -1 if every slot was probed.
+ */
+static int htable_probe(htable h, char *str, unsigned int hash,
+                        int *collisions) {
+  unsigned int i, step;
+  char *key;
+
+  if (h->method == SWISS_G) {
+    return htable_probe_group(h, str, hash, collisions);
+  }
+  i = htable_home_slot(h, hash);
+  step = htable_step(h, hash);
+
+  *collisions = 0;
+  while ((key = htable_slot_key(h, i)) != NULL
+         && (h->hashes[i] != hash || strcmp(key, str) != 0)) {
+    if (++*collisions == h->capacity) {
+      return -1;
+    }
+    i = (i + step) % h->capacity;
+  }
+  return i;
+}
+
+/**
+ * Function: htable_rehash
+ * Purpose: moves every key into a new table of the given capacity, which
+ * also clears out the slots of removed keys. Keys are placed again in the
+ * order they were first inserted, so the stats describe the table as if
+ * it had been created at its new size.
+ *
+ * @param h the htable to rehash.
+ * @param capacity the new capacity, a whole number of groups under group
+ * probing.
+ */
+static void htable_rehash(htable h, int capacity) {
+  int *old_frequencies = h->frequencies;
+  unsigned int *old_hashes = h->hashes;
+  char **old_keys = h->keys;
+  int i, slot, old, rank = 0;
+
+  h->capacity = capacity;
+  if (h->ctrl != NULL) {
+    free(h->ctrl);
+    h->ctrl = emalloc(h->capacity * sizeof h->ctrl[0]);
+    memset(h->ctrl, CTRL_EMPTY, h->capacity);
+  }
+  h->frequencies = emalloc(h->capacity * sizeof h->frequencies[0]);
+  h->hashes = emalloc(h->capacity * sizeof h->hashes[0]);
+  h->keys = emalloc(h->capacity * sizeof h->keys[0]);
+  free(h->ranks);
+  h->ranks = emalloc(h->capacity * sizeof h->ranks[0]);
+
+  for (i = 0; i < h->capacity; i++) {
+    h->frequencies[i] = 0;
+    h->hashes[i] = 0;
+    h->keys[i] = NULL;
+    h->ranks[i] = -1;
+  }
+
+  for (i = 0; i < h->num_ranks; i++) {
+    old = h->order[i];
+    if (old < 0) {
+      continue;
+    }
+    slot = htable_probe(h, old_keys[old], old_hashes[old], &h->stats[rank]);
+    h->hashes[slot] = old_hashes[old];
+    if (h->ctrl != NULL) {
+      h->ctrl[slot] = htable_tag(old_hashes[old]);
+    }
+    h->keys[slot] = old_keys[old];
+    h->frequencies[slot] = old_frequencies[old];
+    h->ranks[slot] = rank;
+    h->order[rank++] = slot;
+  }
+
+  h->stats = erealloc(h->stats, h->capacity * sizeof h->stats[0]);
+  h->order = erealloc(h->order, h->capacity * sizeof h->order[0]);
+  for (i = rank; i < h->capacity; i++) {
+    h->stats[i] = 0;
+    h->order[i] = -1;
+  }
+  h->num_ranks = rank;
+  h->num_deleted = 0;
+
+  free(old_frequencies);
+  free(old_hashes);
+  free(old_keys);
+}
+
+/**
+ * Function: htable_compact
+ * Purpose: closes up the gaps removed keys leave in the insertion order,
+ * so the ranks of the remaining keys run from 0 to num_keys - 1.
+ *
+ * @param h the htable to compact.
+ */
+static void htable_compact(htable h) {
+  int i, rank = 0;
+
+  if (h->num_ranks == h->num_keys) {
+    return;
+  }
+  for (i = 0; i < h->num_ranks; i++) {
+    if (h->order[i] >= 0) {
+      h->stats[rank] = h->stats[i];
+      h->order[rank] = h->order[i];
+      h->ranks[h->order[i]] = rank++;
+    }
+  }
+  for (i = rank; i < h->num_ranks; i++) {
+    h->stats[i] = 0;
+    h->order[i] = -1;
+  }
+  h->num_ranks = rank;
+}
+
+/**
+ * Function: htable_needs_room
+ * Purpose: checks whether a new key can be added to the htable as it is.
+ * Slots holding removed keys count towards the load until a rehash.
+ *
+ * @param h the htable.
+ * @return 1 if htable_make_room has to be called first, otherwise 0.
+ */
+static int htable_needs_room(htable h) {
+  return h->num_keys + h->num_deleted + 1 > h->max_load * h->capacity
+    || h->num_ranks == h->capacity;
+}
+
+/**
+ * Function: htable_make_room
+ * Purpose: makes room for a new key. The htable grows to the next prime
+ * at least twice its capacity, or exactly twice it under group probing,
+ * if the new key would take it past its maximum load. If it is removed
+ * keys filling the table instead, it is rehashed at the same size, or
+ * grown once it is over half of its maximum load.
+ *
+ * @param h the htable to make room in.
+ */
+static void htable_make_room(htable h) {
+  int bigger = h->method == SWISS_G
+    ? 2 * h->capacity : next_prime(2 * h->capacity);
+
+  if (h->num_keys + 1 > h->max_load * h->capacity) {
+    htable_rehash(h, bigger);
+  } else if (h->num_keys + h->num_deleted + 1 > h->max_load * h->capacity) {
+    htable_rehash(h, h->num_keys + 1 > h->max_load * h->capacity / 2
+                  ? bigger : h->capacity);
+  } else if (h->num_ranks == h->capacity) {
+    htable_compact(h);
+  }
+}
+
+/**
+ * Function: htable_add
+ * Purpose: adds to the frequency of a string in the htable, inserting it
+ * first if it is not there, and making room for it if necessary.
+ *
+ * @param h the hash table into which keys are inserted.
+ * @param str the word to be inserted into the container.
+ * @param count how much to add to the frequency of the word.
+ * @return the frequency of the word afterwards.
+ */
+static int htable_add(htable h, char *str, int count) {
+  int collisions;
+  unsigned int hash = htable_hash(h, str);
+  int i = htable_probe(h, str, hash, &collisions);
+
+  if (i >= 0 && h->keys[i] != NULL) {
+    h->frequencies[i] += count;
+    return h->frequencies[i];
+  }
+
+  if (htable_needs_room(h)) {
+    htable_make_room(h);
+    i = htable_probe(h, str, hash, &collisions);
+  }
+
+  h->hashes[i] = hash;
+  if (h->ctrl != NULL) {
+    h->ctrl[i] = htable_tag(hash);
+  }
+  h->keys[i] = arena_strdup(h->key_arena, str);
+  h->frequencies[i] = count;
+  h->ranks[i] = h->num_ranks;
+  h->stats[h->num_ranks] = collisions;
+  h->order[h->num_ranks] = i;
+  h->num_ranks++;
+  h->num_keys++;
+  return count;
+}
+
 /**
  * Function: htable_insert
- * Purpose: inserts a string into the htable.
+ * Purpose: inserts a string into the htable, growing it first if the new
+ * key would take it past its maximum load.
  *
  * @param h the hash table into which keys are inserted.
  * @param str the word to be inserted into the container.
- * @return 0 if the htable is full, 1 if the key is inserted for the first time,
- * or the frequency of that key if it is being inserted again.
+ * @return 1 if the key is inserted for the first time, or the frequency
+ * of that key if it is being inserted again.
  */
 int htable_insert(htable h, char *str) {
+  return htable_add(h, str, 1);
+}
 
-  unsigned int index, hash, i, position, collisions = 0;
-  unsigned int step;
+/**
+ * Function: htable_remove
+ * Purpose: removes a string from the htable. Under linear probing the
+ * keys after it in the probe sequence are shifted back into the gap, so
+ * there are no tombstones and probe sequences stay as short as if the key
+ * had never been inserted. Under double hashing and group probing the slot
+ * is marked as removed instead, and is cleared out by a later rehash.
+ *
+ * @param h the hash table the key is removed from.
+ * @param str the word to be removed.
+ * @return the frequency the word had, or 0 if it was not in the table.
+ */
+int htable_remove(htable h, char *str) {
+  int collisions, freq, j, home;
+  int i = htable_probe(h, str, htable_hash(h, str), &collisions);
 
-  index = htable_word_to_int(str);
-  hash = index % h->capacity;
-  step = htable_step(h, index);
-    
-  if (h->keys[hash] != NULL && strcmp(h->keys[hash], str) == 0) {
-    h->frequencies[hash]++;
-    return h->frequencies[hash];
-  } else {
-    position = hash;
-    i = position;
-    
-    do {
-      if (h->keys[i] == NULL){
-	h->keys[i] = emalloc((strlen(str)+1) * sizeof (h->keys[i][0]));
-	strcpy(h->keys[i], str);
-	h->frequencies[i]++;
-	h->num_keys++;
-	h->stats[h->num_keys] = collisions;
-	return 1;
-        
-      } else if (strcmp(h->keys[i], str) == 0) {
-	collisions++;
-	h->frequencies[i]++;
-	return h->frequencies[i];
+  if (i < 0 || h->keys[i] == NULL) {
+    return 0;
+  }
+  freq = h->frequencies[i];
+  h->order[h->ranks[i]] = -1;
+  h->stats[h->ranks[i]] = 0;
+  h->num_keys--;
+
+  if (h->method != LINEAR_P) {
+    h->keys[i] = TOMBSTONE;
+    h->frequencies[i] = 0;
+    h->ranks[i] = -1;
+    if (h->ctrl != NULL) {
+      h->ctrl[i] = CTRL_DELETED;
+    }
+    h->num_deleted++;
+    return freq;
+  }
+
+  for (j = (i + 1) % h->capacity; j != i && h->keys[j] != NULL;
+       j = (j + 1) % h->capacity) {
+    home = htable_home_slot(h, h->hashes[j]);
+    /* A key can move into the gap unless its home slot lies between
+       the gap and where it is now. */
+    if (i < j ? (home <= i || home > j) : (home <= i && home > j)) {
+      h->keys[i] = h->keys[j];
+      h->hashes[i] = h->hashes[j];
+      h->frequencies[i] = h->frequencies[j];
+      h->ranks[i] = h->ranks[j];
+      h->order[h->ranks[i]] = i;
+      h->stats[h->ranks[i]] = (i - home + h->capacity) % h->capacity;
+      i = j;
+    }
+  }
+  h->keys[i] = NULL;
+  h->hashes[i] = 0;
+  h->frequencies[i] = 0;
+  h->ranks[i] = -1;
+  return freq;
+}
+
+/**
+ * Function: htable_merge
+ * Purpose: adds every key of another htable to this one, along with its
+ * frequency. Keys are added in the order they were first inserted into
+ * the other table, so merging the tables filled from consecutive pieces
+ * of the input, in order, gives the same table as filling it from the
+ * whole input.
+ *
+ * @param h the hash table keys are added to.
+ * @param other the hash table whose keys are added.
+ */
+void htable_merge(htable h, htable other) {
+  int i, slot;
+
+  for (i = 0; i < other->num_ranks; i++) {
+    slot = other->order[i];
+    if (slot >= 0) {
+      htable_add(h, other->keys[slot], other->frequencies[slot]);
+    }
+  }
+}
+
+/**
+ * Function: htable_release_slots
+ * Purpose: frees the slots of a hash table once another structure has
+ * taken over searching its keys, keeping only the keys themselves and
+ * their number. The table is empty afterwards, and can only be asked
+ * how many keys it had or freed. A table mapped in from a file is left
+ * as it is, since its slots are pages of the file which are dropped
+ * from memory once they are no longer used.
+ *
+ * @param h the hash table.
+ */
+void htable_release_slots(htable h) {
+  if (h->image != NULL) {
+    return;
+  }
+  free(h->keys);
+  free(h->frequencies);
+  free(h->hashes);
+  free(h->ctrl);
+  free(h->stats);
+  free(h->order);
+  free(h->ranks);
+  h->keys = NULL;
+  h->frequencies = NULL;
+  h->hashes = NULL;
+  h->ctrl = NULL;
+  h->stats = NULL;
+  h->order = NULL;
+  h->ranks = NULL;
+  h->capacity = 0;
+  h->num_ranks = 0;
+  h->num_deleted = 0;
+}
+
+/**
+ * Function: htable_num_keys
+ * Purpose: counts the keys in the htable.
+ *
+ * @param h the hash table.
+ * @return the number of different keys inserted.
+ */
+int htable_num_keys(htable h) {
+  return h->num_keys;
+}
+
+/**
+ * Function: htable_key
+ * Purpose: finds a key by the order it was first inserted in.
+ *
+ * @param h the hash table.
+ * @param rank the position of the key in insertion order, from 0 to
+ * htable_num_keys(h) - 1.
+ * @param freq set to the frequency of the key.
+ * @return the key.
+ */
+char *htable_key(htable h, int rank, int *freq) {
+  if (h->num_ranks != h->num_keys) {
+    htable_compact(h);
+  }
+  *freq = h->frequencies[h->order[rank]];
+  return htable_slot_key(h, h->order[rank]);
+}
+
+/**
+ * Function: htable_insert_shared
+ * Purpose: inserts a string into a linear probing or double hashing htable
+ * while other threads may be doing the same. An empty slot is claimed with
+ * a compare and swap on its key, and the new key is published with a
+ * release store once its hash and frequency are set. Repeat keys have
+ * their frequency incremented atomically.
+ *
+ * @param h the hash table into which keys are inserted.
+ * @param str the word to be inserted.
+ * @param hash the result of htable_hash for str.
+ * @return 1 if the word was inserted or counted, or 0 if the htable needs
+ * more room before a new key can be added.
+ */
+static int htable_insert_shared(htable h, char *str, unsigned int hash) {
+  unsigned int i = htable_home_slot(h, hash);
+  unsigned int step = htable_step(h, hash);
+  int collisions, rank;
+  char *key, *expected;
+
+  for (collisions = 0; collisions < h->capacity; collisions++) {
+    key = __atomic_load_n(&h->keys[i], __ATOMIC_ACQUIRE);
+    if (key == NULL) {
+      if (__atomic_load_n(&h->num_keys, __ATOMIC_RELAXED) + h->num_deleted
+          + 1 > h->max_load * h->capacity) {
+        return 0;
       }
-      i = (i+step)%h->capacity;
-      collisions++;
-    } while (i != position);
+      expected = NULL;
+      if (__atomic_compare_exchange_n(&h->keys[i], &expected, CLAIMED, 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        rank = __atomic_fetch_add(&h->num_ranks, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->num_keys, 1, __ATOMIC_RELAXED);
+        h->hashes[i] = hash;
+        h->frequencies[i] = 1;
+        h->ranks[i] = rank;
+        h->stats[rank] = collisions;
+        h->order[rank] = i;
+        pthread_mutex_lock(&h->arena_lock);
+        key = arena_strdup(h->key_arena, str);
+        pthread_mutex_unlock(&h->arena_lock);
+        __atomic_store_n(&h->keys[i], key, __ATOMIC_RELEASE);
+        return 1;
+      }
+      key = expected;
+    }
+    while (key == CLAIMED) {
+      key = __atomic_load_n(&h->keys[i], __ATOMIC_ACQUIRE);
+    }
+    if (h->hashes[i] == hash && strcmp(key, str) == 0) {
+      __atomic_fetch_add(&h->frequencies[i], 1, __ATOMIC_RELAXED);
+      return 1;
+    }
+    i = (i + step) % h->capacity;
+  }
+  return 0;
+}
 
-    return 0;
+/**
+ * Function: htable_insert_shared_group
+ * Purpose: the group probing version of htable_insert_shared. An empty
+ * slot is claimed with a compare and swap on its control byte, and the
+ * tag of the new key is published with a release store once the rest of
+ * the slot is set. Slots are checked one at a time in probe order, each
+ * new key taking the first empty slot as htable_probe_group would give,
+ * so a key is never found past an empty slot.
+ *
+ * @param h the hash table into which keys are inserted.
+ * @param str the word to be inserted.
+ * @param hash the result of htable_hash for str.
+ * @return 1 if the word was inserted or counted, or 0 if the htable needs
+ * more room before a new key can be added.
+ */
+static int htable_insert_shared_group(htable h, char *str,
+                                      unsigned int hash) {
+  unsigned int groups = h->capacity / GROUP_SIZE;
+  unsigned int g = htable_home_slot(h, hash) / GROUP_SIZE;
+  unsigned char tag = htable_tag(hash), ctrl, expected;
+  int collisions, rank, i, j;
+  char *key;
+
+  for (collisions = 0; collisions < (int) groups; collisions++) {
+    for (j = 0; j < GROUP_SIZE; j++) {
+      i = g * GROUP_SIZE + j;
+      ctrl = __atomic_load_n(&h->ctrl[i], __ATOMIC_ACQUIRE);
+      if (ctrl == CTRL_EMPTY) {
+        if (__atomic_load_n(&h->num_keys, __ATOMIC_RELAXED) + h->num_deleted
+            + 1 > h->max_load * h->capacity) {
+          return 0;
+        }
+        expected = CTRL_EMPTY;
+        if (__atomic_compare_exchange_n(&h->ctrl[i], &expected,
+                                        CTRL_CLAIMED, 0, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+          rank = __atomic_fetch_add(&h->num_ranks, 1, __ATOMIC_RELAXED);
+          __atomic_fetch_add(&h->num_keys, 1, __ATOMIC_RELAXED);
+          h->hashes[i] = hash;
+          h->frequencies[i] = 1;
+          h->ranks[i] = rank;
+          h->stats[rank] = collisions;
+          h->order[rank] = i;
+          pthread_mutex_lock(&h->arena_lock);
+          key = arena_strdup(h->key_arena, str);
+          pthread_mutex_unlock(&h->arena_lock);
+          h->keys[i] = key;
+          __atomic_store_n(&h->ctrl[i], tag, __ATOMIC_RELEASE);
+          return 1;
+        }
+        ctrl = expected;
+      }
+      while (ctrl == CTRL_CLAIMED) {
+        ctrl = __atomic_load_n(&h->ctrl[i], __ATOMIC_ACQUIRE);
+      }
+      if (ctrl == tag && h->hashes[i] == hash
+          && strcmp(h->keys[i], str) == 0) {
+        __atomic_fetch_add(&h->frequencies[i], 1, __ATOMIC_RELAXED);
+        return 1;
+      }
+    }
+    g = (g + 1) % groups;
   }
   return 0;
 }
 
+/**
+ * Function: htable_insert_concurrent
+ * Purpose: inserts a batch of strings into the htable. Any number of
+ * threads may call this at once, as long as no other htable function is
+ * running. Threads hold a shared lock for a whole batch and insert without
+ * locking each other out. A thread which finds the table too full for a
+ * new key waits for the others to finish their batches and makes room.
+ *
+ * @param h the hash table into which keys are inserted.
+ * @param words the words to be inserted.
+ * @param n the number of words.
+ */
+void htable_insert_concurrent(htable h, char **words, int n) {
+  unsigned int hash;
+  int i;
+
+  /* Ranks are handed out one per claimed slot, so they cannot run past
+     the capacity once the gaps left by removed keys are closed. The
+     counts are only read under the lock, since making room rewrites
+     them. */
+  pthread_rwlock_rdlock(&h->resize_lock);
+  if (__atomic_load_n(&h->num_ranks, __ATOMIC_RELAXED)
+      != __atomic_load_n(&h->num_keys, __ATOMIC_RELAXED)) {
+    pthread_rwlock_unlock(&h->resize_lock);
+    pthread_rwlock_wrlock(&h->resize_lock);
+    htable_compact(h);
+    pthread_rwlock_unlock(&h->resize_lock);
+    pthread_rwlock_rdlock(&h->resize_lock);
+  }
+  for (i = 0; i < n; i++) {
+    hash = htable_hash(h, words[i]);
+    while (!(h->method == SWISS_G
+             ? htable_insert_shared_group(h, words[i], hash)
+             : htable_insert_shared(h, words[i], hash))) {
+      pthread_rwlock_unlock(&h->resize_lock);
+      pthread_rwlock_wrlock(&h->resize_lock);
+      if (htable_needs_room(h)) {
+        htable_make_room(h);
+      }
+      pthread_rwlock_unlock(&h->resize_lock);
+      pthread_rwlock_rdlock(&h->resize_lock);
+    }
+  }
+  pthread_rwlock_unlock(&h->resize_lock);
+}
+
 /**
  * Function: htable_print
  * Purpose: prints out the htable.
@@ -175,10 +985,12 @@ int htable_insert(htable h, char *str) {
 void htable_print(htable h, void f(int freq, char *str)) {
 
   int i;
+  char *key;
 
   for (i = 0; i < h->capacity; i++){
-    if (h->keys[i] != NULL){
-      f(h->frequencies[i], h->keys[i]); 
+    key = htable_slot_key(h, i);
+    if (IS_KEY(key)){
+      f(h->frequencies[i], key); 
     }
   }
 }
@@ -188,22 +1000,30 @@ void htable_print(htable h, void f(int freq, char *str)) {
  * Purpose: prints the entire contents of the htable. 
  *
  * @param h the htable.
+ * @param out the writer to send output to.
  */
-void htable_print_entire_table(htable h, FILE *stream) {
+void htable_print_entire_table(htable h, output out) {
 
   int i;
+  char *key;
 
-  fprintf(stream, "%5s %5s %6s  %s\n", "Pos", "Freq", "Stats", "Word");
-  fprintf(stream, "%s\n", "----------------------------------------");
+  output_puts(out, "Hash: ");
+  output_puts(out, htable_hash_name(h));
+  output_puts(out, "\n  Pos  Freq  Stats  Word\n");
+  output_puts(out, "----------------------------------------\n");
     
   for (i = 0; i < h->capacity; i++) {
-    if (h->keys[i] != NULL) {
-      fprintf(stream, "%5d %5d %5d   %s\n", i, h->frequencies[i],
-	      h->stats[i], h->keys[i]);
-    } else {
-      fprintf(stream, "%5d %5d %5d   %s\n", i, h->frequencies[i],
-	      h->stats[i], "");
+    output_int(out, i, 5);
+    output_putc(out, ' ');
+    output_int(out, h->frequencies[i], 5);
+    output_putc(out, ' ');
+    output_int(out, h->stats[i], 5);
+    output_puts(out, "   ");
+    key = htable_slot_key(h, i);
+    if (IS_KEY(key)) {
+      output_puts(out, key);
     }
+    output_putc(out, '\n');
   }
 }
 
@@ -213,29 +1033,54 @@ void htable_print_entire_table(htable h, FILE *stream) {
  *
  * @param h hash table where keys are searched for.
  * @param str the word to be searched for.
- * @return 0 if number of collisions reached capacity,
+ * @return 0 if the word is not in the table,
  * or the frequency of the word being searched. 
  */
 int htable_search(htable h, char *str) {
+  int collisions;
+  int i = htable_probe(h, str, htable_hash(h, str), &collisions);
 
-  int collisions = 0;
-  unsigned int index = htable_word_to_int(str);
-  unsigned int hash = index % h->capacity;
-  unsigned int step = htable_step(h, hash);
-
-  while (h->keys[hash] != NULL &&
-	 strcmp(str, h->keys[hash]) != 0
-	 && collisions != h->capacity) {
-
-    hash += step;
-    hash %= h->capacity;
-    collisions++;
-  }
-    
-  if (collisions == h->capacity) {
+  if (i < 0) {
     return 0;
   } else {
-    return h->frequencies[hash];
+    return h->frequencies[i];
+  }
+}
+
+
+/**
+ * Function: htable_search_batch
+ * Purpose: searches the hash table for many words at once. The words are
+ * hashed, and the cache lines of their home slots prefetched, a batch at
+ * a time before any of them is looked up, so the cache misses of the
+ * batch overlap instead of being paid one after another.
+ *
+ * @param h hash table where keys are searched for.
+ * @param words the words to be searched for.
+ * @param n the number of words.
+ * @param results set to the result htable_search gives for each word.
+ */
+void htable_search_batch(htable h, char **words, int n, int *results) {
+  unsigned int hashes[BATCH_SIZE];
+  unsigned int slot;
+  int i, j, m, k, collisions;
+
+  for (i = 0; i < n; i += BATCH_SIZE) {
+    m = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+    for (j = 0; j < m; j++) {
+      hashes[j] = htable_hash(h, words[i + j]);
+      slot = htable_home_slot(h, hashes[j]);
+      if (h->ctrl != NULL) {
+        PREFETCH(&h->ctrl[slot]);
+      }
+      PREFETCH(&h->hashes[slot]);
+      PREFETCH(h->keys != NULL ? (void *) &h->keys[slot]
+               : (void *) &h->key_offsets[slot]);
+    }
+    for (j = 0; j < m; j++) {
+      k = htable_probe(h, words[i + j], hashes[j], &collisions);
+      results[i + j] = k < 0 ? 0 : h->frequencies[k];
+    }
   }
 }
 
@@ -247,10 +1092,10 @@ int htable_search(htable h, char *str) {
  * will be printed.
  *
  * @param h - the hash table.
- * @param stream - a stream to print the data to.
+ * @param out - a writer to print the data to.
  * @param percent_full - the point at which to show the data from.
  */
-static void print_stats_line(htable h, FILE *stream, int percent_full) {
+static void print_stats_line(htable h, output out, int percent_full) {
   int current_entries = h->capacity * percent_full / 100;
   double average_collisions = 0.0;
   int at_home = 0;
@@ -268,7 +1113,7 @@ static void print_stats_line(htable h, FILE *stream, int percent_full) {
       average_collisions += h->stats[i];
     }
     
-    fprintf(stream, "%4d %10d %10.1f %10.2f %11d\n", percent_full, 
+    output_printf(out, "%4d %10d %10.1f %10.2f %11d\n", percent_full,
 	    current_entries, at_home * 100.0 / current_entries,
 	    average_collisions / current_entries, max_collisions);
   }
@@ -286,21 +1131,173 @@ static void print_stats_line(htable h, FILE *stream, int percent_full) {
  * @li Maximum Collisions - the most collisions that have occurred
  * while placing a key.
  *
+ * Under group probing a collision is a whole group of slots which had
+ * to be passed over. Removed keys are left out, and a key moved back by
+ * a removal under linear probing counts the collisions of its new slot.
+ *
  * @param h the hashtable to print statistics summary from.
- * @param stream the stream to send output to.
+ * @param out the writer to send output to.
  * @param num_stats the maximum number of statistical snapshots to print.
  */
-void htable_print_stats(htable h, FILE *stream, int num_stats) {
+void htable_print_stats(htable h, output out, int num_stats) {
   int i;
 
-  fprintf(stream, "\n%s\n\n", 
-	  h->method == LINEAR_P ? "Linear Probing" : "Double Hashing"); 
-  fprintf(stream, "Percent   Current   Percent    Average      Maximum\n");
-  fprintf(stream, " Full     Entries   At Home   Collisions   Collisions\n");
-  fprintf(stream, "-----------------------------------------------------\n");
+  htable_compact(h);
+  output_printf(out, "\n%s (hash: %s)\n\n",
+		h->method == LINEAR_P ? "Linear Probing"
+		: h->method == DOUBLE_H ? "Double Hashing" : "Group Probing",
+		htable_hash_name(h));
+  output_puts(out, "Percent   Current   Percent    Average      Maximum\n");
+  output_puts(out, " Full     Entries   At Home   Collisions   Collisions\n");
+  output_puts(out, "-----------------------------------------------------\n");
   for (i = 1; i <= num_stats; i++) {
-    print_stats_line(h, stream, 100 * i / num_stats);
+    print_stats_line(h, out, 100 * i / num_stats);
+  }
+  output_puts(out, "-----------------------------------------------------\n\n");
+}
+
+
+/**
+ * Function: htable_save
+ * Purpose: saves the htable to a file, which htable_load can map back in
+ * and search without building anything. Keys are saved as offsets into
+ * one block of strings, so the file means the same wherever it is
+ * mapped.
+ *
+ * @param h the htable to save.
+ * @param filename the file to save to.
+ * @return 0 if the file was written, or -1 if it could not be.
+ */
+int htable_save(htable h, const char *filename) {
+  snapshot s = snapshot_new(HTABLE_MAGIC, sizeof(struct htable_image));
+  struct htable_image header;
+  uint64_t *offsets = emalloc(h->capacity * sizeof offsets[0]);
+  uint64_t len = 2;
+  char *strings, *key;
+  size_t n = h->capacity;
+  int i;
+
+  htable_compact(h);
+  for (i = 0; i < h->capacity; i++) {
+    key = htable_slot_key(h, i);
+    offsets[i] = key == NULL ? 0 : key == TOMBSTONE ? 1 : len;
+    if (IS_KEY(key)) {
+      len += strlen(key) + 1;
+    }
   }
-  fprintf(stream, "-----------------------------------------------------\n\n");
+  strings = emalloc(len);
+  strings[0] = strings[1] = '\0';
+  for (i = 0; i < h->capacity; i++) {
+    if (offsets[i] > 1) {
+      strcpy(strings + offsets[i], htable_slot_key(h, i));
+    }
+  }
+
+  header.capacity = h->capacity;
+  header.num_keys = h->num_keys;
+  header.method = h->method;
+  header.hash = h->hash;
+  header.frequencies = snapshot_append(s, h->frequencies,
+                                       n * sizeof h->frequencies[0]);
+  header.hashes = snapshot_append(s, h->hashes, n * sizeof h->hashes[0]);
+  header.ctrl = h->ctrl == NULL ? 0
+    : snapshot_append(s, h->ctrl, n * sizeof h->ctrl[0]);
+  header.stats = snapshot_append(s, h->stats, n * sizeof h->stats[0]);
+  header.order = snapshot_append(s, h->order, n * sizeof h->order[0]);
+  header.ranks = snapshot_append(s, h->ranks, n * sizeof h->ranks[0]);
+  header.keys = snapshot_append(s, offsets, n * sizeof offsets[0]);
+  header.strings = snapshot_append(s, strings, len);
+  header.strings_len = len;
+  memcpy(snapshot_header(s), &header, sizeof header);
+  free(strings);
+  free(offsets);
+  return snapshot_save(s, filename);
 }
 
+/**
+ * Function: htable_load
+ * Purpose: maps in an htable saved by htable_save. Its arrays are used
+ * where they lie in the file, so nothing is parsed or copied, but every
+ * key offset and rank is checked to lie within the file, and the
+ * capacity to suit the probing method. The htable can be searched and
+ * printed, but not changed.
+ *
+ * @param filename the file to load.
+ * @param verify whether to check the checksum of the whole file too.
+ * @return the htable, or NULL if the file is not a saved htable.
+ */
+htable htable_load(const char *filename, int verify) {
+  void *header_start;
+  struct htable_image *header;
+  size_t len, n, i;
+  char *image = snapshot_load(filename, HTABLE_MAGIC, sizeof *header,
+                              verify, &header_start, &len);
+  uint64_t *offsets;
+  int *order;
+  htable h;
+
+  if (image == NULL) {
+    return NULL;
+  }
+  header = header_start;
+  n = header->capacity;
+  if (header->capacity <= 0 || header->num_keys < 0
+      || header->num_keys > header->capacity
+      || header->method < LINEAR_P || header->method > SWISS_G
+      || header->hash < JAVA_H || header->hash > XX_H
+      || (header->method == SWISS_G) != (header->ctrl != 0)
+      || (header->method == SWISS_G && header->capacity % GROUP_SIZE != 0)
+      || (header->method == DOUBLE_H && header->capacity < 2)
+      || !snapshot_contains(len, header->frequencies,
+                            n * sizeof h->frequencies[0])
+      || !snapshot_contains(len, header->hashes, n * sizeof h->hashes[0])
+      || !snapshot_contains(len, header->ctrl, n * sizeof h->ctrl[0])
+      || !snapshot_contains(len, header->stats, n * sizeof h->stats[0])
+      || !snapshot_contains(len, header->order, n * sizeof h->order[0])
+      || !snapshot_contains(len, header->ranks, n * sizeof h->ranks[0])
+      || !snapshot_contains(len, header->keys,
+                            n * sizeof h->key_offsets[0])
+      || !snapshot_contains(len, header->strings, header->strings_len)
+      || header->strings_len < 2
+      || image[header->strings + header->strings_len - 1] != '\0') {
+    snapshot_unload(image, len);
+    return NULL;
+  }
+  /* Every key ends before the end of the strings, so a key offset
+     within them is enough to keep its key within the file. */
+  offsets = (uint64_t *) (image + header->keys);
+  order = (int *) (image + header->order);
+  for (i = 0; i < n; i++) {
+    if (offsets[i] >= header->strings_len
+        || ((int) i < header->num_keys
+            && (order[i] < 0 || order[i] >= header->capacity))) {
+      snapshot_unload(image, len);
+      return NULL;
+    }
+  }
+
+  h = emalloc(sizeof *h);
+  h->capacity = header->capacity;
+  h->num_keys = header->num_keys;
+  h->num_ranks = header->num_keys;
+  h->num_deleted = 0;
+  h->method = (hashing_t) header->method;
+  h->hash = (hash_t) header->hash;
+  h->max_load = 1.0;
+  h->frequencies = (int *) (image + header->frequencies);
+  h->hashes = (unsigned int *) (image + header->hashes);
+  h->ctrl = header->ctrl == 0 ? NULL
+    : (unsigned char *) (image + header->ctrl);
+  h->stats = (int *) (image + header->stats);
+  h->order = (int *) (image + header->order);
+  h->ranks = (int *) (image + header->ranks);
+  h->keys = NULL;
+  h->key_offsets = (uint64_t *) (image + header->keys);
+  h->key_base = image + header->strings;
+  h->key_arena = NULL;
+  h->image = image;
+  h->image_len = len;
+  pthread_rwlock_init(&h->resize_lock, NULL);
+  pthread_mutex_init(&h->arena_lock, NULL);
+  return h;
+}
@@ -7,6 +7,7 @@
 #define HTABLE_H_
 
 #include <stdio.h>
+#include "output.h"
 
 /**
  * Struct: htablerec
@@ -14,7 +15,9 @@
  */
 typedef struct htablerec *htable;
 
-typedef enum hashing_e { LINEAR_P, DOUBLE_H } hashing_t;
+typedef enum hashing_e { LINEAR_P, DOUBLE_H, SWISS_G } hashing_t;
+
+typedef enum hash_e { JAVA_H, WORD_H, XX_H } hash_t;
 
 /**
  * Prototypes
@@ -23,9 +26,19 @@ typedef enum hashing_e { LINEAR_P, DOUBLE_H } hashing_t;
  */
 extern void htable_free(htable h);
 extern int htable_insert(htable h, char *str);
-extern htable htable_new(int capacity, hashing_t method);
+extern void htable_insert_concurrent(htable h, char **words, int n);
+extern void htable_release_slots(htable h);
+extern int htable_remove(htable h, char *str);
+extern void htable_merge(htable h, htable other);
+extern int htable_num_keys(htable h);
+extern char *htable_key(htable h, int rank, int *freq);
+extern htable htable_load(const char *filename, int verify);
+extern htable htable_new(int capacity, hashing_t method, hash_t hash,
+                         double max_load);
 extern void htable_print(htable h, void f(int freq, char *str));
-extern void htable_print_entire_table(htable h, FILE *stream);
+extern void htable_print_entire_table(htable h, output out);
+extern int htable_save(htable h, const char *filename);
 extern int htable_search(htable h, char *str);
-extern void htable_print_stats(htable h, FILE *stream, int num_stats);
+extern void htable_search_batch(htable h, char **words, int n, int *results);
+extern void htable_print_stats(htable h, output out, int num_stats);
 #endif
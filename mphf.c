@@ -0,0 +1,375 @@
+/**
+ * File: mphf.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mylib.h"
+#include "mphf.h"
+
+/* The average number of keys given the same pilot. */
+#define BUCKET_SIZE 4
+
+/* The keys fill this fraction of the positions pilots choose from, so
+   the last buckets placed still find free positions quickly. */
+#define LOAD 0.99
+
+/* A bucket which cannot be placed with this many pilots makes the build
+   start again with another seed. */
+#define MAX_PILOT (1 << 20)
+
+#define BATCH_SIZE 16
+
+/**
+ * Struct: mphf_slot
+ * Purpose: declares the variables for the one word kept in a slot. The
+ * full hash is compared before the word, so a word which is not in the
+ * table is almost never compared at all.
+ */
+struct mphf_slot {
+  uint64_t hash;
+  char *key;
+  int frequency;
+};
+
+/**
+ * Struct: mphfrec
+ * Purpose: declares the variables for a minimal perfect hash table. Each
+ * key hashes to a bucket, and the pilot of the bucket, found when the
+ * table was built, sends every key of the bucket to a different
+ * position. Positions run to num_positions, a little more than the
+ * number of keys, and the few keys sent beyond the last slot are
+ * remapped to the slots left free below it. A search then reads one
+ * pilot and one slot. The keys themselves belong to the caller.
+ */
+struct mphfrec {
+  unsigned int num_keys;
+  unsigned int num_buckets;
+  unsigned int num_positions;
+  uint64_t seed;
+  uint32_t *pilots;
+  uint32_t *remap;
+  struct mphf_slot *slots;
+  size_t key_bytes;
+};
+
+/**
+ * Function: mix
+ * Purpose: scrambles the bits of a number, the finaliser of MurmurHash3.
+ *
+ * @param x the number.
+ * @return the scrambled number.
+ */
+static uint64_t mix(uint64_t x){
+  x ^= x >> 33;
+  x *= UINT64_C(0xFF51AFD7ED558CCD);
+  x ^= x >> 33;
+  x *= UINT64_C(0xC4CEB9FE1A85EC53);
+  x ^= x >> 33;
+  return x;
+}
+
+/**
+ * Function: range
+ * Purpose: maps 32 bits of hash onto one of n values by a multiply and
+ * shift.
+ *
+ * @param hash the bits of hash.
+ * @param n the number of values.
+ * @return a value from 0 to n - 1.
+ */
+static unsigned int range(uint32_t hash, unsigned int n){
+  return (unsigned int) (((uint64_t) hash * n) >> 32);
+}
+
+/**
+ * Function: mphf_bucket
+ * Purpose: finds the bucket of a hash, from its top 32 bits.
+ *
+ * @param f the table.
+ * @param hash the hash of a key.
+ * @return the bucket.
+ */
+static unsigned int mphf_bucket(mphf f, uint64_t hash){
+  return range((uint32_t) (hash >> 32), f->num_buckets);
+}
+
+/**
+ * Function: mphf_position
+ * Purpose: finds the position a pilot sends a hash to.
+ *
+ * @param f the table.
+ * @param hash the hash of a key.
+ * @param pilot the pilot of its bucket.
+ * @return the position, from 0 to num_positions - 1.
+ */
+static unsigned int mphf_position(mphf f, uint64_t hash, uint32_t pilot){
+  return range((uint32_t) (mix(hash ^ mix(pilot + 1)) >> 32),
+               f->num_positions);
+}
+
+/**
+ * Function: mphf_slot_of
+ * Purpose: finds the slot of a hash.
+ *
+ * @param f the table.
+ * @param hash the hash of a word.
+ * @return the only slot which can hold the word.
+ */
+static struct mphf_slot *mphf_slot_of(mphf f, uint64_t hash){
+  unsigned int pos = mphf_position(f, hash, f->pilots[mphf_bucket(f, hash)]);
+
+  return &f->slots[pos < f->num_keys ? pos : f->remap[pos - f->num_keys]];
+}
+
+/**
+ * Function: mphf_place
+ * Purpose: finds a pilot for every bucket, the biggest buckets first
+ * while most positions are still free.
+ *
+ * @param f the table, with its sizes and seed set.
+ * @param hashes the hashes of the keys.
+ * @param positions set to the position of each key.
+ * @return 1 if every bucket was placed, 0 if one could not be.
+ */
+static int mphf_place(mphf f, uint64_t *hashes, unsigned int *positions){
+  unsigned int nb = f->num_buckets, n = f->num_keys;
+  unsigned int *start = emalloc((nb + 1) * sizeof start[0]);
+  unsigned int *members = emalloc((n + 1) * sizeof members[0]);
+  unsigned int *order = emalloc((nb + 1) * sizeof order[0]);
+  unsigned int *by_size, *tried;
+  unsigned char *taken = emalloc(f->num_positions);
+  unsigned int i, j, k, b, size, max_size = 0, pos;
+  uint32_t pilot;
+  int placed = 1;
+
+  /* Counting sorts list the keys of each bucket together, and the
+     buckets from the biggest down. */
+  memset(start, 0, (nb + 1) * sizeof start[0]);
+  for (i = 0; i < n; i++){
+    start[mphf_bucket(f, hashes[i]) + 1]++;
+  }
+  for (b = 0; b < nb; b++){
+    if (start[b + 1] > max_size){
+      max_size = start[b + 1];
+    }
+    start[b + 1] += start[b];
+  }
+  memcpy(order, start, (nb + 1) * sizeof start[0]);
+  for (i = 0; i < n; i++){
+    members[order[mphf_bucket(f, hashes[i])]++] = i;
+  }
+  by_size = emalloc((max_size + 2) * sizeof by_size[0]);
+  memset(by_size, 0, (max_size + 2) * sizeof by_size[0]);
+  for (b = 0; b < nb; b++){
+    by_size[max_size - (start[b + 1] - start[b]) + 1]++;
+  }
+  for (size = 0; size <= max_size; size++){
+    by_size[size + 1] += by_size[size];
+  }
+  for (b = 0; b < nb; b++){
+    order[by_size[max_size - (start[b + 1] - start[b])]++] = b;
+  }
+
+  tried = emalloc((max_size + 1) * sizeof tried[0]);
+  memset(taken, 0, f->num_positions);
+  for (i = 0; i < nb && placed; i++){
+    b = order[i];
+    size = start[b + 1] - start[b];
+    for (pilot = 0; pilot < MAX_PILOT; pilot++){
+      for (j = 0; j < size; j++){
+        pos = mphf_position(f, hashes[members[start[b] + j]], pilot);
+        for (k = 0; k < j && tried[k] != pos; k++)
+          ;
+        if (taken[pos] || k < j){
+          break;
+        }
+        tried[j] = pos;
+      }
+      if (j == size){
+        break;
+      }
+    }
+    if (pilot == MAX_PILOT){
+      placed = 0;
+    } else {
+      f->pilots[b] = pilot;
+      for (j = 0; j < size; j++){
+        taken[tried[j]] = 1;
+        positions[members[start[b] + j]] = tried[j];
+      }
+    }
+  }
+  free(tried);
+  free(by_size);
+  free(taken);
+  free(order);
+  free(members);
+  free(start);
+  return placed;
+}
+
+/**
+ * Function: mphf_new
+ * Purpose: builds a minimal perfect hash table holding a set of keys,
+ * with a slot for each key and no more. The keys are not copied, so
+ * they must stay where they are for as long as the table is used.
+ *
+ * @param keys the keys, which must all be different.
+ * @param freqs the frequency of each key.
+ * @param n the number of keys.
+ * @return the new table.
+ */
+mphf mphf_new(char **keys, int *freqs, int n){
+  mphf f = emalloc(sizeof *f);
+  uint64_t *hashes = emalloc((n + 1) * sizeof hashes[0]);
+  unsigned int *positions;
+  unsigned int i, free_slot = 0;
+
+  f->num_keys = n;
+  f->num_buckets = n / BUCKET_SIZE + 1;
+  f->num_positions = (unsigned int) (n / LOAD) + 1;
+  f->pilots = emalloc(f->num_buckets * sizeof f->pilots[0]);
+  positions = emalloc((f->num_buckets > f->num_keys ? f->num_buckets
+                       : f->num_keys + 1) * sizeof positions[0]);
+  f->seed = 0;
+  do {
+    f->seed++;
+    for (i = 0; i < f->num_keys; i++){
+      hashes[i] = hash_xx64(keys[i], strlen(keys[i]), f->seed);
+    }
+  } while (!mphf_place(f, hashes, positions));
+
+  /* Keys placed past the last slot take the free slots in order. The
+     positions past it which no key took still lead to a real slot, for
+     the words which are not keys. */
+  f->remap = emalloc((f->num_positions - f->num_keys)
+                     * sizeof f->remap[0]);
+  memset(f->remap, 0, (f->num_positions - f->num_keys)
+         * sizeof f->remap[0]);
+  f->slots = emalloc((f->num_keys + 1) * sizeof f->slots[0]);
+  f->key_bytes = 0;
+  for (i = 0; i < f->num_keys; i++){
+    f->slots[i].key = NULL;
+  }
+  for (i = 0; i < f->num_keys; i++){
+    if (positions[i] < f->num_keys){
+      f->slots[positions[i]].key = keys[i];
+    }
+  }
+  for (i = 0; i < f->num_keys; i++){
+    if (positions[i] >= f->num_keys){
+      while (f->slots[free_slot].key != NULL){
+        free_slot++;
+      }
+      f->remap[positions[i] - f->num_keys] = free_slot;
+      positions[i] = free_slot;
+      f->slots[free_slot].key = keys[i];
+    }
+  }
+  for (i = 0; i < f->num_keys; i++){
+    f->slots[positions[i]].hash = hashes[i];
+    f->key_bytes += strlen(keys[i]) + 1;
+    f->slots[positions[i]].frequency = freqs[i];
+  }
+  free(positions);
+  free(hashes);
+  return f;
+}
+
+/**
+ * Function: mphf_search
+ * Purpose: searches the table for a word, with one probe.
+ *
+ * @param f the table.
+ * @param str the word to search for.
+ * @return the frequency of the word, or 0 if it is not in the table.
+ */
+int mphf_search(mphf f, char *str){
+  uint64_t hash = hash_xx64(str, strlen(str), f->seed);
+  struct mphf_slot *slot;
+
+  if (f->num_keys == 0){
+    return 0;
+  }
+  slot = mphf_slot_of(f, hash);
+  return slot->hash == hash && strcmp(slot->key, str) == 0
+    ? slot->frequency : 0;
+}
+
+/**
+ * Function: mphf_search_batch
+ * Purpose: searches the table for many words at once. The pilots of a
+ * batch of words are prefetched, then their slots, before any word is
+ * compared, so the cache misses of the batch overlap.
+ *
+ * @param f the table.
+ * @param words the words to search for.
+ * @param n the number of words.
+ * @param results set to the result mphf_search gives for each word.
+ */
+void mphf_search_batch(mphf f, char **words, int n, int *results){
+  uint64_t hashes[BATCH_SIZE];
+  struct mphf_slot *slots[BATCH_SIZE];
+  int i, j, m;
+
+  for (i = 0; i < n; i += BATCH_SIZE){
+    m = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+    for (j = 0; j < m; j++){
+      hashes[j] = hash_xx64(words[i + j], strlen(words[i + j]), f->seed);
+      if (f->num_keys > 0){
+        PREFETCH(&f->pilots[mphf_bucket(f, hashes[j])]);
+      }
+    }
+    for (j = 0; j < m && f->num_keys > 0; j++){
+      slots[j] = mphf_slot_of(f, hashes[j]);
+      PREFETCH(slots[j]);
+    }
+    for (j = 0; j < m; j++){
+      results[i + j] = f->num_keys > 0 && slots[j]->hash == hashes[j]
+        && strcmp(slots[j]->key, words[i + j]) == 0
+        ? slots[j]->frequency : 0;
+    }
+  }
+}
+
+/**
+ * Function: mphf_size
+ * Purpose: gives the memory the table itself takes up, not counting the
+ * keys it points at, which belong to the caller.
+ *
+ * @param f the table.
+ * @return the size of the table in bytes.
+ */
+size_t mphf_size(mphf f){
+  return f->num_buckets * sizeof f->pilots[0]
+    + (f->num_positions - f->num_keys) * sizeof f->remap[0]
+    + f->num_keys * sizeof f->slots[0];
+}
+
+/**
+ * Function: mphf_key_bytes
+ * Purpose: gives the memory taken up by the keys the table points at,
+ * which have to be kept as long as the table is.
+ *
+ * @param f the table.
+ * @return the size of the keys in bytes, counting their terminators.
+ */
+size_t mphf_key_bytes(mphf f){
+  return f->key_bytes;
+}
+
+/**
+ * Function: mphf_free
+ * Purpose: frees all the memory allocated to the table, but not the
+ * keys.
+ *
+ * @param f the table.
+ */
+void mphf_free(mphf f){
+  free(f->slots);
+  free(f->remap);
+  free(f->pilots);
+  free(f);
+}
@@ -0,0 +1,30 @@
+/**
+ * File: mphf.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef MPHF_H_
+#define MPHF_H_
+
+#include <stddef.h>
+
+/**
+ * Struct: mphfrec
+ * Purpose: defines a struct type of mphfrec for a minimal perfect hash
+ * table, which holds a fixed set of words in exactly one slot per word.
+ */
+typedef struct mphfrec *mphf;
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the mphf.c file,
+ * based on their signatures.
+ */
+extern void mphf_free(mphf f);
+extern size_t mphf_key_bytes(mphf f);
+extern mphf mphf_new(char **keys, int *freqs, int n);
+extern int mphf_search(mphf f, char *str);
+extern void mphf_search_batch(mphf f, char **words, int n, int *results);
+extern size_t mphf_size(mphf f);
+
+#endif
@@ -7,8 +7,51 @@
 #include <stdlib.h>
 #include <assert.h> 
 #include <ctype.h>
+#include <string.h>
 #include "mylib.h"
 
+#define ARENA_CHUNK_SIZE 65536
+
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/**
+ * Union: arena_align
+ * Purpose: a type with the strictest alignment that arena_alloc has to
+ * honour.
+ */
+union arena_align {
+    long l;
+    double d;
+    void *p;
+};
+
+/**
+ * Struct: arena_chunk
+ * Purpose: the header of one block of memory handed out by an arena. The
+ * memory itself follows the header.
+ */
+struct arena_chunk {
+    struct arena_chunk *next;
+    union arena_align align;
+};
+
+/**
+ * Struct: arenarec
+ * Purpose: declares the variables for an arena. Memory is taken from the
+ * front of the newest chunk until it runs out.
+ */
+struct arenarec {
+    struct arena_chunk *chunks;
+    char *next;
+    size_t left;
+};
+
 /**
  * Function: emalloc
  * Purpose: allocates a block of memory.
@@ -76,3 +119,178 @@ int getword(char *s, int limit, FILE *stream)
     *w = '\0';
     return w-s;
 }
+
+
+/**
+ * Function: read64
+ * Purpose: reads up to 8 bytes of a string as one integer, padding a
+ * short read with zeros.
+ *
+ * @param p the first byte to read.
+ * @param len how many bytes to read, at most 8.
+ * @return the bytes as an integer in native byte order.
+ */
+static uint64_t read64(const char *p, size_t len){
+    uint64_t w = 0;
+    memcpy(&w, p, len);
+    return w;
+}
+
+/**
+ * Function: hash_word64
+ * Purpose: hashes a string a machine word (8 bytes) at a time, with a
+ * multiply and xor-shift per word and a final mix so every bit of the
+ * result depends on every byte.
+ *
+ * @param str the string to hash.
+ * @param len the length of the string.
+ * @return the 64 bit hash of the string.
+ */
+uint64_t hash_word64(const char *str, size_t len){
+    uint64_t h = len * PRIME64_5;
+
+    for (; len >= 8; len -= 8, str += 8){
+        h = (h ^ read64(str, 8)) * PRIME64_1;
+        h ^= h >> 29;
+    }
+    h = (h ^ read64(str, len)) * PRIME64_1;
+    h ^= h >> 32;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    return h;
+}
+
+/**
+ * Function: hash_xx64
+ * Purpose: hashes a string with the short input path of XXH64, which
+ * consumes 8 bytes, then 4, then single bytes before a final avalanche.
+ * Words are short, so the four lane loop for long inputs is left out.
+ *
+ * @param str the string to hash.
+ * @param len the length of the string.
+ * @param seed a value which selects a different hash function.
+ * @return the 64 bit hash of the string.
+ */
+uint64_t hash_xx64(const char *str, size_t len, uint64_t seed){
+    uint64_t h = seed + PRIME64_5 + len;
+    uint64_t k;
+
+    for (; len >= 8; len -= 8, str += 8){
+        k = read64(str, 8) * PRIME64_2;
+        k = ROTL64(k, 31) * PRIME64_1;
+        h ^= k;
+        h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (len >= 4){
+        h ^= read64(str, 4) * PRIME64_1;
+        h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+        len -= 4;
+        str += 4;
+    }
+    for (; len > 0; len--, str++){
+        h ^= (unsigned char) *str * PRIME64_5;
+        h = ROTL64(h, 11) * PRIME64_1;
+    }
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * Function: arena_new
+ * Purpose: creates a new, empty arena.
+ *
+ * @return the new arena.
+ */
+arena arena_new(void){
+    arena a = emalloc(sizeof *a);
+    a->chunks = NULL;
+    a->next = NULL;
+    a->left = 0;
+    return a;
+}
+
+/**
+ * Function: arena_alloc
+ * Purpose: allocates a block of memory from an arena. The block lives
+ * until the whole arena is freed.
+ *
+ * @param a the arena to allocate from.
+ * @param s the size (bytes) of memory required for allocation.
+ * @return the memory address where it has been allocated.
+ */
+void *arena_alloc(arena a, size_t s){
+    size_t align = sizeof (union arena_align);
+    size_t pad = (align - (size_t) a->next % align) % align;
+    struct arena_chunk *chunk;
+    void *result;
+
+    if (s + pad > a->left){
+        if (s > ARENA_CHUNK_SIZE / 4){
+            /* Large blocks get a chunk of their own, so the rest of the
+               current chunk is not wasted. */
+            chunk = emalloc(sizeof *chunk + s);
+            if (a->chunks != NULL){
+                chunk->next = a->chunks->next;
+                a->chunks->next = chunk;
+            } else {
+                chunk->next = NULL;
+                a->chunks = chunk;
+            }
+            return &chunk->align;
+        }
+        chunk = emalloc(sizeof *chunk + ARENA_CHUNK_SIZE);
+        chunk->next = a->chunks;
+        a->chunks = chunk;
+        a->next = (char *) &chunk->align;
+        a->left = ARENA_CHUNK_SIZE;
+        pad = 0;
+    }
+    result = a->next + pad;
+    a->next += pad + s;
+    a->left -= pad + s;
+    return result;
+}
+
+/**
+ * Function: arena_strdup
+ * Purpose: copies a string into memory allocated from an arena. Strings
+ * are packed one after another, without padding between them.
+ *
+ * @param a the arena to allocate from.
+ * @param str the string to copy.
+ * @return the copy of the string.
+ */
+char *arena_strdup(arena a, const char *str){
+    size_t s = strlen(str) + 1;
+    char *result;
+
+    if (s > a->left){
+        return memcpy(arena_alloc(a, s), str, s);
+    }
+    result = a->next;
+    a->next += s;
+    a->left -= s;
+    return memcpy(result, str, s);
+}
+
+/**
+ * Function: arena_free
+ * Purpose: frees all of the memory allocated from an arena, and the arena
+ * itself.
+ *
+ * @param a the arena to be freed.
+ */
+void arena_free(arena a){
+    struct arena_chunk *chunk;
+
+    while (a->chunks != NULL){
+        chunk = a->chunks;
+        a->chunks = chunk->next;
+        free(chunk);
+    }
+    free(a);
+}
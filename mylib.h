@@ -7,8 +7,27 @@
 #define MYLIB_H_
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/**
+ * Macro: PREFETCH
+ * Purpose: asks the processor to start loading the cache line holding an
+ * address, on compilers which support it.
+ */
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void) (p))
+#endif
+
+/**
+ * Struct: arenarec
+ * Purpose: defining a struct type of arenarec for bump-pointer allocation
+ * of memory which is all released together.
+ */
+typedef struct arenarec *arena;
+
 /**
  * Prototypes
  * Purpose: specifies functions to be implemented in the mylib.c file, based on
@@ -17,5 +36,11 @@
 extern void *emalloc(size_t);
 extern void *erealloc(void *, size_t);
 extern int getword(char *,int,FILE *);
+extern uint64_t hash_word64(const char *str, size_t len);
+extern uint64_t hash_xx64(const char *str, size_t len, uint64_t seed);
+extern arena arena_new(void);
+extern void *arena_alloc(arena a, size_t s);
+extern char *arena_strdup(arena a, const char *str);
+extern void arena_free(arena a);
 
 #endif
@@ -0,0 +1,238 @@
+/**
+ * File: output.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include "mylib.h"
+#include "output.h"
+
+/* Output is written this many bytes at a time. */
+#define OUTPUT_SIZE (1 << 18)
+
+/* The room output_printf and output_int make sure of before
+   formatting into the buffer. */
+#define OUTPUT_LINE 256
+
+/**
+ * Struct: outputrec
+ * Purpose: declares the variables for an output writer. Output is
+ * gathered in buffer and only written once it is full or flushed, so
+ * each word printed costs a copy rather than a call into stdio.
+ */
+struct outputrec {
+  int fd;
+  size_t used;
+  char *buffer;
+};
+
+/**
+ * Function: output_new
+ * Purpose: creates a writer for a file descriptor, such as 1 for stdout
+ * or 2 for stderr.
+ *
+ * @param fd the file descriptor to write to.
+ * @return the new writer.
+ */
+output output_new(int fd){
+  output o = emalloc(sizeof *o);
+
+  o->fd = fd;
+  o->used = 0;
+  o->buffer = emalloc(OUTPUT_SIZE);
+  return o;
+}
+
+/**
+ * Function: output_send
+ * Purpose: writes bytes to the file descriptor, carrying on after a
+ * partial write or an interrupted one. Output is dropped once a write
+ * fails.
+ *
+ * @param o the writer.
+ * @param str the bytes.
+ * @param len the number of bytes.
+ */
+static void output_send(output o, const char *str, size_t len){
+  ssize_t done;
+
+  while (len > 0 && o->fd >= 0){
+    done = write(o->fd, str, len);
+    if (done < 0){
+      if (errno != EINTR){
+        o->fd = -1;
+      }
+    } else {
+      str += done;
+      len -= done;
+    }
+  }
+}
+
+/**
+ * Function: output_flush
+ * Purpose: writes out everything gathered so far.
+ *
+ * @param o the writer.
+ */
+void output_flush(output o){
+
+  output_send(o, o->buffer, o->used);
+  o->used = 0;
+}
+
+/**
+ * Function: output_reserve
+ * Purpose: makes sure there is room for some more bytes in the buffer.
+ *
+ * @param o the writer.
+ * @param len the number of bytes, at most OUTPUT_SIZE.
+ */
+static void output_reserve(output o, size_t len){
+
+  if (OUTPUT_SIZE - o->used < len){
+    output_flush(o);
+  }
+}
+
+/**
+ * Function: output_write
+ * Purpose: adds bytes to the output. Anything larger than the buffer is
+ * written straight out.
+ *
+ * @param o the writer.
+ * @param str the bytes.
+ * @param len the number of bytes.
+ */
+void output_write(output o, const char *str, size_t len){
+
+  output_reserve(o, len < OUTPUT_SIZE ? len : OUTPUT_SIZE);
+  if (len >= OUTPUT_SIZE){
+    output_send(o, str, len);
+  } else {
+    memcpy(o->buffer + o->used, str, len);
+    o->used += len;
+  }
+}
+
+/**
+ * Function: output_puts
+ * Purpose: adds a string to the output, without adding a newline.
+ *
+ * @param o the writer.
+ * @param str the string.
+ */
+void output_puts(output o, const char *str){
+  output_write(o, str, strlen(str));
+}
+
+/**
+ * Function: output_putc
+ * Purpose: adds a character to the output.
+ *
+ * @param o the writer.
+ * @param c the character.
+ */
+void output_putc(output o, char c){
+
+  if (o->used == OUTPUT_SIZE){
+    output_flush(o);
+  }
+  o->buffer[o->used++] = c;
+}
+
+/**
+ * Function: output_int
+ * Purpose: adds an integer to the output, padded with spaces to a width
+ * as printf does. The digits are worked out from the right into a small
+ * buffer, which is much cheaper than parsing a format each time.
+ *
+ * @param o the writer.
+ * @param value the integer.
+ * @param width the least width, padded on the left, or padded on the
+ * right if negative, like the - flag of printf. At most OUTPUT_LINE.
+ */
+void output_int(output o, int value, int width){
+  char digits[12];
+  unsigned int u = value < 0 ? 0u - (unsigned int) value : (unsigned int) value;
+  int n = 0, left = width < 0;
+
+  if (left){
+    width = -width;
+  }
+  do {
+    digits[n++] = (char) ('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (value < 0){
+    digits[n++] = '-';
+  }
+  output_reserve(o, OUTPUT_LINE);
+  for (; !left && width > n; width--){
+    o->buffer[o->used++] = ' ';
+  }
+  width -= n;
+  while (n > 0){
+    o->buffer[o->used++] = digits[--n];
+  }
+  for (; width > 0; width--){
+    o->buffer[o->used++] = ' ';
+  }
+}
+
+/**
+ * Function: output_printf
+ * Purpose: adds formatted output, as printf does, for anything that
+ * output_int and output_puts cannot give. Output too long for the room
+ * left in the buffer is formatted again into memory of its own and
+ * written from there.
+ *
+ * @param o the writer.
+ * @param format the format, followed by the values it uses.
+ */
+void output_printf(output o, const char *format, ...){
+  size_t room;
+  va_list args;
+  char *line;
+  int len;
+
+  output_reserve(o, OUTPUT_LINE);
+  room = OUTPUT_SIZE - o->used;
+  va_start(args, format);
+  len = vsnprintf(o->buffer + o->used, room, format, args);
+  va_end(args);
+  if (len < 0){
+    return;
+  }
+  if ((size_t) len < room){
+    o->used += len;
+    return;
+  }
+  line = emalloc(len + 1);
+  va_start(args, format);
+  vsnprintf(line, len + 1, format, args);
+  va_end(args);
+  output_write(o, line, len);
+  free(line);
+}
+
+/**
+ * Function: output_free
+ * Purpose: writes out anything left and frees all the memory allocated
+ * to the writer.
+ *
+ * @param o the writer.
+ */
+void output_free(output o){
+
+  output_flush(o);
+  free(o->buffer);
+  free(o);
+}
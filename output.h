@@ -0,0 +1,32 @@
+/**
+ * File: output.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <stddef.h>
+
+/**
+ * Struct: outputrec
+ * Purpose: defines a struct type of outputrec to gather output in a large
+ * buffer and write it to a file descriptor a block at a time.
+ */
+typedef struct outputrec *output;
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the output.c file,
+ * based on their signatures.
+ */
+extern void output_flush(output o);
+extern void output_free(output o);
+extern void output_int(output o, int value, int width);
+extern output output_new(int fd);
+extern void output_printf(output o, const char *format, ...);
+extern void output_putc(output o, char c);
+extern void output_puts(output o, const char *str);
+extern void output_write(output o, const char *str, size_t len);
+
+#endif
@@ -0,0 +1,564 @@
+/**
+ * File: server.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "mylib.h"
+#include "server.h"
+
+/* Requests are read, and looked up, up to this many bytes and words at
+   a time. */
+#define SERVER_BUFFER (1 << 16)
+#define SERVER_BATCH 64
+
+/* No more requests are read from a client while this many bytes of its
+   answers are still waiting to be sent. */
+#define SERVER_QUEUE (1 << 20)
+
+/* The client sends this many words before reading their answers. The
+   answers to a window always fit in the socket buffers, so neither end
+   blocks the other. */
+#define CLIENT_WINDOW 1024
+
+#define MAX_WORD 255
+
+/* Set by a signal to stop the server. */
+static volatile sig_atomic_t stopping;
+
+/**
+ * Struct: batch
+ * Purpose: declares the variables for the answers to one read of
+ * requests: when they were read, how many there were, and where in the
+ * queued answers the last of them ends.
+ */
+struct batch {
+  double start;
+  int served;
+  size_t end;
+};
+
+/**
+ * Struct: connection
+ * Purpose: declares the variables for a client of the server: the
+ * requests read but not yet answered, which may end part way through a
+ * line, whether the rest of a line too long to read is being dropped,
+ * the answers not yet sent and the batches they belong to, whether the
+ * client has sent all its requests, and the latency of the requests it
+ * has been answered.
+ */
+struct connection {
+  int fd;
+  char *in;
+  size_t len;
+  int skipping;
+  char *out;
+  size_t out_len;
+  size_t out_sent;
+  size_t out_size;
+  struct batch *batches;
+  int num_batches;
+  int max_batches;
+  int closing;
+  long requests;
+  double latency;
+  double max_latency;
+};
+
+/**
+ * Function: now
+ * Purpose: reads a monotonic wall clock.
+ *
+ * @return the time in seconds.
+ */
+static double now(void){
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Function: on_signal
+ * Purpose: asks the server to stop once it next wakes up.
+ *
+ * @param sig the signal.
+ */
+static void on_signal(int sig){
+  (void) sig;
+  stopping = 1;
+}
+
+/**
+ * Function: write_all
+ * Purpose: writes every byte of a buffer to a socket.
+ *
+ * @param fd the socket.
+ * @param buf the bytes.
+ * @param len the number of bytes.
+ * @return 0 once all are written, or -1 if the socket failed.
+ */
+static int write_all(int fd, const char *buf, size_t len){
+  ssize_t done;
+
+  while (len > 0){
+    done = write(fd, buf, len);
+    if (done < 0 && errno != EINTR){
+      return -1;
+    }
+    if (done > 0){
+      buf += done;
+      len -= done;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Function: fold_query
+ * Purpose: turns a request line into the word getword would read from
+ * it: the first run of letters and digits, in lowercase, with any
+ * apostrophes in it dropped.
+ *
+ * @param line the line, without its newline.
+ * @param len the length of the line.
+ * @param word set to the word, which may be empty.
+ */
+static void fold_query(const char *line, size_t len, char *word){
+  const unsigned char *c = (const unsigned char *) line;
+  size_t i = 0;
+  int n = 0;
+
+  while (i < len && !isalnum(c[i])){
+    i++;
+  }
+  for (; i < len && n < MAX_WORD && (isalnum(c[i]) || c[i] == '\''); i++){
+    if (c[i] != '\''){
+      word[n++] = tolower(c[i]);
+    }
+  }
+  word[n] = '\0';
+}
+
+/**
+ * Function: serve_requests
+ * Purpose: answers every whole line a client has sent so far, a batch
+ * of words at a time, and queues the answers to be sent.
+ *
+ * @param c the client.
+ * @param lookup the function looking words up in the dictionary.
+ * @param dict the dictionary.
+ * @param start when the latest requests were read.
+ */
+static void serve_requests(struct connection *c,
+                           void lookup(void *dict, char **words, int n,
+                                       int *results),
+                           void *dict, double start){
+  char batch[SERVER_BATCH][MAX_WORD + 1];
+  char *words[SERVER_BATCH];
+  int results[SERVER_BATCH];
+  char *end;
+  size_t from = 0;
+  int i, n, served = 0;
+
+  for (i = 0; i < SERVER_BATCH; i++){
+    words[i] = batch[i];
+  }
+  do {
+    for (n = 0; n < SERVER_BATCH; n++){
+      end = memchr(c->in + from, '\n', c->len - from);
+      if (end == NULL){
+        break;
+      }
+      fold_query(c->in + from, end - (c->in + from), batch[n]);
+      from = end + 1 - c->in;
+    }
+    lookup(dict, words, n, results);
+    if (c->out_len + n * 12 > c->out_size){
+      while (c->out_len + n * 12 > c->out_size){
+        c->out_size = c->out_size == 0 ? 4096 : 2 * c->out_size;
+      }
+      c->out = erealloc(c->out, c->out_size);
+    }
+    for (i = 0; i < n; i++){
+      c->out_len += sprintf(c->out + c->out_len, "%d\n", results[i]);
+    }
+    served += n;
+  } while (n == SERVER_BATCH);
+
+  memmove(c->in, c->in + from, c->len - from);
+  c->len -= from;
+  if (served > 0){
+    if (c->num_batches == c->max_batches){
+      c->max_batches = c->max_batches == 0 ? 8 : 2 * c->max_batches;
+      c->batches = erealloc(c->batches,
+                            c->max_batches * sizeof c->batches[0]);
+    }
+    c->batches[c->num_batches].start = start;
+    c->batches[c->num_batches].served = served;
+    c->batches[c->num_batches].end = c->out_len;
+    c->num_batches++;
+  }
+}
+
+/**
+ * Function: send_answers
+ * Purpose: sends as many of a client's queued answers as its socket
+ * takes without blocking. The latency of each request is the time from
+ * its line being read to its answer being sent.
+ *
+ * @param c the client.
+ * @return 0, or -1 if the socket failed.
+ */
+static int send_answers(struct connection *c){
+  ssize_t done;
+  double latency;
+  int i, j;
+
+  while (c->out_sent < c->out_len){
+    done = write(c->fd, c->out + c->out_sent, c->out_len - c->out_sent);
+    if (done < 0){
+      if (errno == EINTR){
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK){
+        break;
+      }
+      return -1;
+    }
+    c->out_sent += done;
+  }
+  if (c->out_sent == 0){
+    return 0;
+  }
+
+  for (i = 0; i < c->num_batches && c->batches[i].end <= c->out_sent; i++){
+    latency = now() - c->batches[i].start;
+    c->requests += c->batches[i].served;
+    c->latency += latency * c->batches[i].served;
+    if (latency > c->max_latency){
+      c->max_latency = latency;
+    }
+  }
+  for (j = 0; i + j < c->num_batches; j++){
+    c->batches[j] = c->batches[i + j];
+    c->batches[j].end -= c->out_sent;
+  }
+  c->num_batches = j;
+  memmove(c->out, c->out + c->out_sent, c->out_len - c->out_sent);
+  c->out_len -= c->out_sent;
+  c->out_sent = 0;
+  return 0;
+}
+
+/**
+ * Function: read_requests
+ * Purpose: reads what a client has sent and answers every whole line of
+ * it.
+ *
+ * @param c the client.
+ * @param lookup the function looking words up in the dictionary.
+ * @param dict the dictionary.
+ * @return 0, or -1 if the socket failed.
+ */
+static int read_requests(struct connection *c,
+                         void lookup(void *dict, char **words, int n,
+                                     int *results),
+                         void *dict){
+  ssize_t got = read(c->fd, c->in + c->len, SERVER_BUFFER - c->len);
+  double start = now();
+  char *end;
+  size_t from;
+
+  if (got == 0){
+    c->closing = 1;
+    return 0;
+  } else if (got < 0){
+    return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK
+      ? 0 : -1;
+  }
+  c->len += got;
+  if (c->skipping){
+    end = memchr(c->in, '\n', c->len);
+    from = end == NULL ? c->len : (size_t) (end + 1 - c->in);
+    memmove(c->in, c->in + from, c->len - from);
+    c->len -= from;
+    c->skipping = end == NULL;
+  }
+  /* A line too long for the buffer is answered for the part read, and
+     the rest of it dropped. */
+  if (c->len == SERVER_BUFFER && memchr(c->in, '\n', SERVER_BUFFER) == NULL){
+    c->in[SERVER_BUFFER - 1] = '\n';
+    c->skipping = 1;
+  }
+  serve_requests(c, lookup, dict, start);
+  return 0;
+}
+
+/**
+ * Function: report
+ * Purpose: logs the requests and latency of a client once it leaves,
+ * and lets go of it.
+ *
+ * @param c the client.
+ * @param log the writer to log to.
+ */
+static void report(struct connection *c, output log){
+  output_printf(log, "Client %d: %ld requests, mean latency %.1f us, "
+                "max %.1f us\n", c->fd, c->requests,
+                c->requests > 0 ? c->latency / c->requests * 1e6 : 0.0,
+                c->max_latency * 1e6);
+  output_flush(log);
+  close(c->fd);
+  free(c->in);
+  free(c->out);
+  free(c->batches);
+}
+
+/**
+ * Function: server_run
+ * Purpose: answers lookups over a Unix domain socket until the server
+ * is sent SIGINT or SIGTERM. Each request is a line holding a word,
+ * which is read the way getword reads one: the first run of letters
+ * and digits, lowercased, without apostrophes. Each answer is a line
+ * holding the frequency of that word in the dictionary as a decimal
+ * number, whichever data structure holds it, or 0 for an unknown word
+ * or a line with no word on it. Clients may send any number of
+ * requests without waiting for the answers, which come back in order.
+ * Many clients are served at once, each batch of requests as it
+ * arrives. Sockets never block the server: answers a client is not
+ * reading are queued, and its requests are left unread while too many
+ * are.
+ *
+ * @param path where to create the socket. A socket left there by an
+ * earlier server is replaced, but nothing else is.
+ * @param lookup the function looking words up in the dictionary, given
+ * at most SERVER_BATCH (64) words at a time, which sets the frequency
+ * of each.
+ * @param dict the dictionary, passed to lookup.
+ * @param log the writer to log clients and errors to.
+ * @return 0 once stopped, or -1 if the socket could not be created.
+ */
+int server_run(const char *path,
+               void lookup(void *dict, char **words, int n, int *results),
+               void *dict, output log){
+  struct sockaddr_un addr;
+  struct sigaction action;
+  struct stat st;
+  struct pollfd *fds = NULL;
+  struct connection *clients = NULL;
+  struct connection *c;
+  int listener, fd, i, num_clients = 0, max_clients = 0;
+  long total = 0;
+
+  if (strlen(path) >= sizeof addr.sun_path){
+    output_printf(log, "Error: socket path is too long\n");
+    return -1;
+  }
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)){
+    unlink(path);
+  }
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 || bind(listener, (struct sockaddr *) &addr, sizeof addr)
+      != 0 || listen(listener, 64) != 0){
+    output_puts(log, "Error: cannot listen on ");
+    output_puts(log, path);
+    output_putc(log, '\n');
+    if (listener >= 0){
+      close(listener);
+    }
+    return -1;
+  }
+
+  memset(&action, 0, sizeof action);
+  action.sa_handler = on_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  action.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &action, NULL);
+  output_puts(log, "Listening on ");
+  output_puts(log, path);
+  output_putc(log, '\n');
+  output_flush(log);
+
+  fds = emalloc(sizeof fds[0]);
+  while (!stopping){
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    for (i = 0; i < num_clients; i++){
+      fds[i + 1].fd = clients[i].fd;
+      fds[i + 1].events = 0;
+      if (!clients[i].closing && clients[i].out_len < SERVER_QUEUE){
+        fds[i + 1].events |= POLLIN;
+      }
+      if (clients[i].out_len > 0){
+        fds[i + 1].events |= POLLOUT;
+      }
+    }
+    if (poll(fds, num_clients + 1, -1) < 0){
+      continue;
+    }
+
+    for (i = num_clients - 1; i >= 0; i--){
+      c = &clients[i];
+      if (fds[i + 1].revents == 0){
+        continue;
+      }
+      if ((fds[i + 1].revents & POLLNVAL)
+          || ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+              && (fds[i + 1].events & POLLIN)
+              && read_requests(c, lookup, dict) != 0)
+          || send_answers(c) != 0 || (c->closing && c->out_len == 0)){
+        total += c->requests;
+        report(c, log);
+        clients[i] = clients[--num_clients];
+      }
+    }
+
+    if (fds[0].revents & POLLIN){
+      fd = accept(listener, NULL, NULL);
+      if (fd >= 0){
+        if (num_clients == max_clients){
+          max_clients = max_clients == 0 ? 8 : 2 * max_clients;
+          clients = erealloc(clients, max_clients * sizeof clients[0]);
+          fds = erealloc(fds, (max_clients + 1) * sizeof fds[0]);
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        c = &clients[num_clients++];
+        memset(c, 0, sizeof *c);
+        c->fd = fd;
+        c->in = emalloc(SERVER_BUFFER);
+      }
+    }
+  }
+
+  for (i = 0; i < num_clients; i++){
+    total += clients[i].requests;
+    report(&clients[i], log);
+  }
+  close(listener);
+  unlink(path);
+  output_printf(log, "Served %ld requests\n", total);
+  free(clients);
+  free(fds);
+  return 0;
+}
+
+/**
+ * Function: client_run
+ * Purpose: looks up the words of the input through a server, a window
+ * of words at a time, and logs the round trip latency.
+ *
+ * @param path the socket of the server.
+ * @param in the words to look up.
+ * @param f another function passed in with the answer and the word.
+ * @param log the writer to log the latency and errors to.
+ * @return 0 once every word is answered, or -1 if the server could not
+ * be reached or went away.
+ */
+int client_run(const char *path, tokenizer in, void f(int freq, char *str),
+               output log){
+  struct sockaddr_un addr;
+  char (*window)[MAX_WORD + 1] = emalloc(CLIENT_WINDOW * sizeof window[0]);
+  char *requests = emalloc(CLIENT_WINDOW * (MAX_WORD + 2));
+  char answers[4096];
+  char *word;
+  int fd, n, i, len, answer = 0, windows = 0, failed = 0;
+  size_t used;
+  ssize_t got;
+  long total = 0;
+  double start, round_trip, latency = 0.0, max_latency = 0.0;
+
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof addr) != 0){
+    output_puts(log, "Error: cannot connect to ");
+    output_puts(log, path);
+    output_putc(log, '\n');
+    if (fd >= 0){
+      close(fd);
+      fd = -1;
+    }
+    failed = -1;
+  }
+
+  while (failed == 0){
+    for (n = 0, used = 0; n < CLIENT_WINDOW
+           && (len = tokenizer_next(in, &word)) != EOF; n++){
+      memcpy(window[n], word, len + 1);
+      memcpy(requests + used, word, len);
+      used += len;
+      requests[used++] = '\n';
+    }
+    if (n == 0){
+      break;
+    }
+    start = now();
+    if (write_all(fd, requests, used) != 0){
+      failed = -1;
+      break;
+    }
+    /* The answers are digits, one line for each word in order. */
+    for (i = 0; i < n && failed == 0; ){
+      got = read(fd, answers, sizeof answers);
+      if (got <= 0){
+        if (got < 0 && errno == EINTR){
+          continue;
+        }
+        failed = -1;
+      }
+      for (len = 0; len < got; len++){
+        if (answers[len] == '\n'){
+          f(answer, window[i++]);
+          answer = 0;
+        } else {
+          answer = 10 * answer + (answers[len] - '0');
+        }
+      }
+    }
+    round_trip = now() - start;
+    latency += round_trip;
+    if (round_trip > max_latency){
+      max_latency = round_trip;
+    }
+    total += n;
+    windows++;
+  }
+
+  if (failed != 0 && fd >= 0){
+    output_puts(log, "Error: lost the server\n");
+  }
+  if (windows > 0){
+    output_printf(log, "Requests      = %ld\n", total);
+    output_printf(log, "Round trip    : mean %.1f us, max %.1f us for "
+                  "up to %d words\n", latency / windows * 1e6,
+                  max_latency * 1e6, CLIENT_WINDOW);
+    output_printf(log, "Per word      : %.3f us\n", latency / total * 1e6);
+  }
+  if (fd >= 0){
+    close(fd);
+  }
+  free(requests);
+  free(window);
+  return failed;
+}
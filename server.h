@@ -0,0 +1,24 @@
+/**
+ * File: server.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "output.h"
+#include "tokenizer.h"
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the server.c file,
+ * based on their signatures.
+ */
+extern int client_run(const char *path, tokenizer in,
+                      void f(int freq, char *str), output log);
+extern int server_run(const char *path,
+                      void lookup(void *dict, char **words, int n,
+                                  int *results),
+                      void *dict, output log);
+
+#endif
@@ -0,0 +1,252 @@
+/**
+ * File: snapshot.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mylib.h"
+#include "snapshot.h"
+
+/* Every section of an image starts on a multiple of this many bytes,
+   so the arrays in it can be used where they are mapped. */
+#define ALIGN 8
+
+/**
+ * Struct: snapshot_header
+ * Purpose: declares the start of every image file. The magic names the
+ * kind of data structure and the version of its layout. The checksum
+ * covers every byte after this header, up to the length of the file,
+ * and the header checksum just the header of the data structure, which
+ * comes straight after it.
+ */
+struct snapshot_header {
+  char magic[8];
+  uint64_t length;
+  uint64_t checksum;
+  uint64_t header_checksum;
+};
+
+/**
+ * Struct: snapshotrec
+ * Purpose: declares the variables for an image being built, which grows
+ * as sections are appended, and the size of its data structure header.
+ */
+struct snapshotrec {
+  char *data;
+  size_t len;
+  size_t size;
+  size_t header_len;
+};
+
+/**
+ * Function: align_up
+ * Purpose: rounds a length up to a whole number of ALIGN bytes.
+ *
+ * @param len the length.
+ * @return the rounded length.
+ */
+static size_t align_up(size_t len){
+  return (len + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+/**
+ * Function: snapshot_new
+ * Purpose: starts an image with room for its headers.
+ *
+ * @param magic the 8 bytes naming the kind of image.
+ * @param header_len the size of the header of the data structure.
+ * @return the new image.
+ */
+snapshot snapshot_new(const char *magic, size_t header_len){
+  snapshot s = emalloc(sizeof *s);
+
+  s->header_len = header_len;
+  s->len = align_up(sizeof(struct snapshot_header) + header_len);
+  s->size = s->len < 4096 ? 4096 : s->len;
+  s->data = emalloc(s->size);
+  memset(s->data, 0, s->len);
+  memcpy(((struct snapshot_header *) s->data)->magic, magic, 8);
+  return s;
+}
+
+/**
+ * Function: snapshot_header
+ * Purpose: finds the header of the data structure in an image, to be
+ * filled in. It moves when a section is appended.
+ *
+ * @param s the image.
+ * @return the header of the data structure.
+ */
+void *snapshot_header(snapshot s){
+  return s->data + sizeof(struct snapshot_header);
+}
+
+/**
+ * Function: snapshot_append
+ * Purpose: adds a section to the end of an image.
+ *
+ * @param s the image.
+ * @param data the bytes of the section.
+ * @param len the number of bytes.
+ * @return the offset of the section from the start of the file.
+ */
+uint64_t snapshot_append(snapshot s, const void *data, size_t len){
+  size_t offset = s->len;
+
+  while (s->size < offset + align_up(len)){
+    s->size *= 2;
+    s->data = erealloc(s->data, s->size);
+  }
+  memcpy(s->data + offset, data, len);
+  memset(s->data + offset + len, 0, align_up(len) - len);
+  s->len = offset + align_up(len);
+  return offset;
+}
+
+/**
+ * Function: snapshot_checksum
+ * Purpose: works out the checksum of an image.
+ *
+ * @param image the image.
+ * @param len the length of the image.
+ * @return the checksum of everything after the image header.
+ */
+static uint64_t snapshot_checksum(const char *image, size_t len){
+  size_t skip = sizeof(struct snapshot_header);
+
+  return hash_xx64(image + skip, len - skip, len);
+}
+
+/**
+ * Function: snapshot_save
+ * Purpose: fills in the length and checksums of an image, writes it to a
+ * file and frees it. The image is written in full to FILENAME.tmp and
+ * synced before being renamed over the file, so the file is never left
+ * holding part of an image.
+ *
+ * @param s the image.
+ * @param filename the file to write, which is replaced if it exists.
+ * @return 0 if the file was written, or -1 if it could not be.
+ */
+int snapshot_save(snapshot s, const char *filename){
+  struct snapshot_header *header = (struct snapshot_header *) s->data;
+  char *temp = emalloc(strlen(filename) + 5);
+  FILE *file;
+  int result = -1;
+
+  header->length = s->len;
+  header->checksum = snapshot_checksum(s->data, s->len);
+  header->header_checksum = hash_xx64((char *) (header + 1), s->header_len,
+                                      s->len);
+  sprintf(temp, "%s.tmp", filename);
+  file = fopen(temp, "wb");
+  if (file != NULL){
+    if (fwrite(s->data, 1, s->len, file) == s->len && fflush(file) == 0
+        && fsync(fileno(file)) == 0){
+      result = 0;
+    }
+    if (fclose(file) != 0){
+      result = -1;
+    }
+    if (result == 0 && rename(temp, filename) != 0){
+      result = -1;
+    }
+    if (result != 0){
+      remove(temp);
+    }
+  }
+  free(temp);
+  free(s->data);
+  free(s);
+  return result;
+}
+
+/**
+ * Function: snapshot_load
+ * Purpose: maps an image file into memory, read only, so the data
+ * structure in it can be used where it lies. The file must be of the
+ * kind named by the magic, as long as its header says, and match the
+ * checksum of the header of the data structure. Only the headers are
+ * read, so loading takes the same time however big the file is, unless
+ * every byte is to be checked against the checksum of the whole image
+ * as well. The caller still has to check every offset it reads from the
+ * image against its length.
+ *
+ * @param filename the file to map.
+ * @param magic the 8 bytes naming the kind of image expected.
+ * @param header_len the size of the header of the data structure.
+ * @param verify whether to check the checksum of the whole image.
+ * @param header set to the header of the data structure.
+ * @param len set to the length of the image.
+ * @return the image, or NULL if the file is missing or not a valid
+ * image of that kind.
+ */
+void *snapshot_load(const char *filename, const char *magic,
+                    size_t header_len, int verify, void **header,
+                    size_t *len){
+  struct snapshot_header *start;
+  struct stat st;
+  void *image;
+  int fd = open(filename, O_RDONLY);
+
+  if (fd < 0){
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size
+      < align_up(sizeof(struct snapshot_header) + header_len)){
+    close(fd);
+    return NULL;
+  }
+  *len = st.st_size;
+  image = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED){
+    return NULL;
+  }
+  start = image;
+  if (memcmp(start->magic, magic, 8) != 0 || start->length != *len
+      || start->header_checksum != hash_xx64((char *) (start + 1),
+                                             header_len, *len)
+      || (verify && start->checksum != snapshot_checksum(image, *len))){
+    munmap(image, *len);
+    return NULL;
+  }
+  *header = start + 1;
+  return image;
+}
+
+/**
+ * Function: snapshot_contains
+ * Purpose: tells whether a section lies wholly within an image, and
+ * starts on a multiple of ALIGN bytes as snapshot_append leaves every
+ * section, so its array can be read where it is mapped.
+ *
+ * @param len the length of the image.
+ * @param offset the offset of the section.
+ * @param size the size of the section.
+ * @return 1 if it does, otherwise 0.
+ */
+int snapshot_contains(size_t len, uint64_t offset, uint64_t size){
+  return offset % ALIGN == 0 && offset <= len && size <= len - offset;
+}
+
+/**
+ * Function: snapshot_unload
+ * Purpose: unmaps an image loaded by snapshot_load.
+ *
+ * @param image the image.
+ * @param len the length of the image.
+ */
+void snapshot_unload(void *image, size_t len){
+  munmap(image, len);
+}
@@ -0,0 +1,34 @@
+/**
+ * File: snapshot.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Struct: snapshotrec
+ * Purpose: defines a struct type of snapshotrec to build the image of a
+ * data structure in memory before it is saved to a file.
+ */
+typedef struct snapshotrec *snapshot;
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the snapshot.c file,
+ * based on their signatures.
+ */
+extern uint64_t snapshot_append(snapshot s, const void *data, size_t len);
+extern int snapshot_contains(size_t len, uint64_t offset, uint64_t size);
+extern void *snapshot_header(snapshot s);
+extern void *snapshot_load(const char *filename, const char *magic,
+                           size_t header_len, int verify, void **header,
+                           size_t *len);
+extern snapshot snapshot_new(const char *magic, size_t header_len);
+extern int snapshot_save(snapshot s, const char *filename);
+extern void snapshot_unload(void *image, size_t len);
+
+#endif
@@ -0,0 +1,104 @@
+#!/bin/sh
+#
+# File: run-tests.sh
+# @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+#
+# Runs the program on generated input and compares the output of options
+# which should agree. Usage: tests/run-tests.sh [path to asgn]
+
+ASGN=${1:-./asgn}
+TMP=${TMPDIR:-/tmp}/asgn-tests.$$
+failures=0
+
+mkdir -p "$TMP"
+trap 'rm -rf "$TMP"' EXIT
+
+# check NAME EXPECTED ACTUAL: fails unless the two files match.
+check() {
+  if cmp -s "$2" "$3"; then
+    echo "ok   $1"
+  else
+    echo "FAIL $1"
+    failures=$((failures + 1))
+  fi
+}
+
+# same INPUT OPTIONS OTHER: fails unless the program prints the same with
+# OPTIONS as with OTHER when reading INPUT.
+same() {
+  "$ASGN" $2 < "$1" > "$TMP/expected" 2>/dev/null
+  "$ASGN" $3 < "$1" > "$TMP/actual" 2>/dev/null
+  check "$2 / $3" "$TMP/expected" "$TMP/actual"
+}
+
+# A dictionary in sorted order, some words given more than once.
+awk 'BEGIN { for (i = 0; i < 20000; i++) { printf "w%05d\n", i;
+             if (i % 7 == 0) printf "w%05d\n", i } }' > "$TMP/sorted.txt"
+
+for tree in -T "-T -r" "-T -B"; do
+  same "$TMP/sorted.txt" "$tree" "$tree -P 4 -S"
+done
+
+# Every third word of the sorted dictionary removed again with -R, along
+# with words it never had, gives the words of a dictionary without them.
+awk 'NR % 3 == 0 { print; print "x" $0 }' "$TMP/sorted.txt" > "$TMP/removed.txt"
+awk 'NR == FNR { gone[$0] = 1; next } !($0 in gone)' "$TMP/removed.txt" \
+  "$TMP/sorted.txt" > "$TMP/kept.txt"
+"$ASGN" < "$TMP/kept.txt" | sort > "$TMP/expected"
+for structure in "" -d -g -T "-T -r" "-T -B"; do
+  "$ASGN" $structure -R "$TMP/removed.txt" < "$TMP/sorted.txt" \
+    | sort > "$TMP/actual"
+  check "-R $structure / words never added" "$TMP/expected" "$TMP/actual"
+done
+
+# Words in shuffled order, 40 of them tied with the lowest count kept by
+# -k 30, which keeps the first of those alphabetically.
+awk 'BEGIN { srand(1);
+             for (i = 0; i < 20; i++) for (j = 0; j <= 5 + i; j++)
+               printf "%d top%02d\n", rand() * 1000000, i;
+             for (i = 0; i < 40; i++) for (j = 0; j < 5; j++)
+               printf "%d tie%02d\n", rand() * 1000000, i;
+             for (i = 0; i < 100; i++)
+               printf "%d low%02d\n", rand() * 1000000, i }' \
+  | sort -n | cut -d' ' -f2 > "$TMP/ties.txt"
+"$ASGN" < "$TMP/ties.txt" | LC_ALL=C sort -k1,1nr -k2,2 | head -30 \
+  > "$TMP/top"
+for structure in "" -T -A "-T -r" "-T -B"; do
+  "$ASGN" $structure -k 30 < "$TMP/ties.txt" > "$TMP/actual"
+  check "-k 30 $structure / sorted frequencies" "$TMP/top" "$TMP/actual"
+done
+
+# serve SOCKET OPTIONS: starts a server on SOCKET with the dictionary in
+# sorted.txt, and waits until it is listening.
+serve() {
+  "$ASGN" $2 -U "$1" < "$TMP/sorted.txt" 2>/dev/null &
+  server=$!
+  tries=0
+  while [ ! -S "$1" ] && [ $tries -lt 100 ]; do
+    sleep 0.1
+    tries=$((tries + 1))
+  done
+}
+
+# The server answers with the frequency of each word whichever structure
+# holds the dictionary, the hash table's answers being the reference.
+cat "$TMP/removed.txt" "$TMP/kept.txt" > "$TMP/lookups.txt"
+"$ASGN" -W "$TMP/tree.snap" -T < "$TMP/sorted.txt" > /dev/null
+"$ASGN" -W "$TMP/table.snap" < "$TMP/sorted.txt" > /dev/null
+serve "$TMP/socket" ""
+"$ASGN" -C "$TMP/socket" < "$TMP/lookups.txt" > "$TMP/expected" 2>/dev/null
+kill $server
+wait $server 2>/dev/null
+for structure in -d -g -M -F -T "-T -r" "-T -B" -A "-T -L $TMP/tree.snap" \
+                 "-L $TMP/table.snap"; do
+  serve "$TMP/socket" "$structure"
+  "$ASGN" -C "$TMP/socket" < "$TMP/lookups.txt" > "$TMP/actual" 2>/dev/null
+  kill $server
+  wait $server 2>/dev/null
+  check "-U $structure / frequencies" "$TMP/expected" "$TMP/actual"
+done
+
+if [ $failures -ne 0 ]; then
+  echo "$failures failed"
+  exit 1
+fi
@@ -0,0 +1,506 @@
+/**
+ * File: tokenizer.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mylib.h"
+#include "tokenizer.h"
+
+/* Word boundaries are found a vector at a time with SSE2, or with AVX2
+   where the processor has it. */
+#if defined(__GNUC__) && defined(__SSE2__)
+#define VECTOR_SCAN
+#include <immintrin.h>
+#endif
+
+/* Input which cannot be mapped is read this many bytes at a time. */
+#define READ_SIZE (1 << 20)
+
+/* The longest word getword returns from a 256 byte buffer. Longer runs
+   of letters and digits are split into words of this length. */
+#define MAX_WORD 255
+
+/* Classes in the byte table which are not the lowercase form of a byte
+   to keep. */
+#define SEPARATOR 0
+#define APOSTROPHE 1
+
+/**
+ * Struct: tokenizerrec
+ * Purpose: declares the variables for a tokenizer. The input is either a
+ * mapped file, memory owned by the caller, or a buffer refilled from a
+ * file descriptor. Each word is folded into word as it is scanned.
+ */
+struct tokenizerrec {
+  const unsigned char *data;
+  size_t pos;
+  size_t end;
+  void *map;
+  size_t map_len;
+  unsigned char *buffer;
+  int fd;
+  size_t (*skip)(const unsigned char *data, size_t pos, size_t end);
+  size_t (*span)(const unsigned char *data, size_t pos, size_t end,
+                 int *apostrophe);
+  char word[MAX_WORD + 1 + 16];
+};
+
+/* What each byte means to a word: a separator, an apostrophe, which is
+   skipped inside a word, or a letter or digit, given in lowercase. Only
+   ASCII counts, as with isalnum in the C locale. */
+static const unsigned char byte_class[256] = {
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   1,   0,   0,   0,   0,   0,   0,   0,   0,
+   48,  49,  50,  51,  52,  53,  54,  55,  56,  57,   0,   0,   0,   0,   0,   0,
+    0,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111,
+  112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122,   0,   0,   0,   0,   0,
+    0,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111,
+  112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0
+};
+
+/**
+ * Function: skip_scalar
+ * Purpose: finds the start of the next word, a byte at a time.
+ *
+ * @param data the input.
+ * @param pos where to start looking.
+ * @param end the end of the input.
+ * @return the position of the first letter or digit, or end if there is
+ * none.
+ */
+static size_t skip_scalar(const unsigned char *data, size_t pos,
+                          size_t end){
+
+  while (pos < end && byte_class[data[pos]] <= APOSTROPHE){
+    pos++;
+  }
+  return pos;
+}
+
+/**
+ * Function: span_scalar
+ * Purpose: finds the end of a word, a byte at a time.
+ *
+ * @param data the input.
+ * @param pos the start of the word.
+ * @param end where to stop looking.
+ * @param apostrophe set to 1 if the word has an apostrophe, else 0.
+ * @return the position of the first separator, or end if there is none.
+ */
+static size_t span_scalar(const unsigned char *data, size_t pos, size_t end,
+                          int *apostrophe){
+  unsigned char c;
+
+  *apostrophe = 0;
+  for (; pos < end; pos++){
+    c = byte_class[data[pos]];
+    if (c == SEPARATOR){
+      break;
+    }
+    *apostrophe |= c == APOSTROPHE;
+  }
+  return pos;
+}
+
+#ifdef VECTOR_SCAN
+/**
+ * Function: alnum_sse2
+ * Purpose: classifies 16 bytes at once. Bytes from 0x80 up are negative
+ * to the signed comparisons, so they fall outside both ranges.
+ *
+ * @param x the bytes.
+ * @return a mask with bit i set if byte i is a letter or digit.
+ */
+static unsigned int alnum_sse2(__m128i x){
+  __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+  __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('0' - 1)),
+                                _mm_cmplt_epi8(x, _mm_set1_epi8('9' + 1)));
+  __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+
+  return (unsigned int) _mm_movemask_epi8(_mm_or_si128(digit, alpha));
+}
+
+/**
+ * Function: skip_sse2
+ * Purpose: finds the start of the next word, 16 bytes at a time.
+ *
+ * @param data the input.
+ * @param pos where to start looking.
+ * @param end the end of the input.
+ * @return the position of the first letter or digit, or end if there is
+ * none.
+ */
+static size_t skip_sse2(const unsigned char *data, size_t pos, size_t end){
+  unsigned int mask;
+
+  for (; pos + 16 <= end; pos += 16){
+    mask = alnum_sse2(_mm_loadu_si128((const __m128i *) (data + pos)));
+    if (mask != 0){
+      return pos + __builtin_ctz(mask);
+    }
+  }
+  return skip_scalar(data, pos, end);
+}
+
+/**
+ * Function: span_sse2
+ * Purpose: finds the end of a word, 16 bytes at a time. The separators
+ * are the bytes which are neither letters, digits nor apostrophes, and
+ * the lowest of them ends the word.
+ *
+ * @param data the input.
+ * @param pos the start of the word.
+ * @param end where to stop looking.
+ * @param apostrophe set to 1 if the word has an apostrophe, else 0.
+ * @return the position of the first separator, or end if there is none.
+ */
+static size_t span_sse2(const unsigned char *data, size_t pos, size_t end,
+                        int *apostrophe){
+  unsigned int alnum, quote, sep;
+  __m128i x;
+  int rest;
+
+  for (; pos + 16 <= end; pos += 16){
+    x = _mm_loadu_si128((const __m128i *) (data + pos));
+    alnum = alnum_sse2(x);
+    quote = (unsigned int)
+      _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\'')));
+    sep = ~(alnum | quote) & 0xffff;
+    if (sep != 0){
+      /* Only apostrophes below the separator belong to the word. */
+      sep &= -sep;
+      *apostrophe = (quote & (sep - 1)) != 0;
+      return pos + __builtin_ctz(sep);
+    }
+    if (quote != 0){
+      pos = span_scalar(data, pos, end, apostrophe);
+      *apostrophe = 1;
+      return pos;
+    }
+  }
+  pos = span_scalar(data, pos, end, &rest);
+  *apostrophe = rest;
+  return pos;
+}
+
+/**
+ * Function: alnum_avx2
+ * Purpose: classifies 32 bytes at once, as alnum_sse2 does 16.
+ *
+ * @param x the bytes.
+ * @return a mask with bit i set if byte i is a letter or digit.
+ */
+__attribute__((target("avx2")))
+static unsigned int alnum_avx2(__m256i x){
+  __m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+  __m256i digit =
+    _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('0' - 1)),
+                     _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), x));
+  __m256i alpha =
+    _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                     _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+
+  return (unsigned int) _mm256_movemask_epi8(_mm256_or_si256(digit, alpha));
+}
+
+/**
+ * Function: skip_avx2
+ * Purpose: finds the start of the next word, 32 bytes at a time.
+ *
+ * @param data the input.
+ * @param pos where to start looking.
+ * @param end the end of the input.
+ * @return the position of the first letter or digit, or end if there is
+ * none.
+ */
+__attribute__((target("avx2")))
+static size_t skip_avx2(const unsigned char *data, size_t pos, size_t end){
+  unsigned int mask;
+
+  for (; pos + 32 <= end; pos += 32){
+    mask = alnum_avx2(_mm256_loadu_si256((const __m256i *) (data + pos)));
+    if (mask != 0){
+      return pos + __builtin_ctz(mask);
+    }
+  }
+  return skip_sse2(data, pos, end);
+}
+
+/**
+ * Function: span_avx2
+ * Purpose: finds the end of a word, 32 bytes at a time, as span_sse2
+ * does 16.
+ *
+ * @param data the input.
+ * @param pos the start of the word.
+ * @param end where to stop looking.
+ * @param apostrophe set to 1 if the word has an apostrophe, else 0.
+ * @return the position of the first separator, or end if there is none.
+ */
+__attribute__((target("avx2")))
+static size_t span_avx2(const unsigned char *data, size_t pos, size_t end,
+                        int *apostrophe){
+  unsigned int alnum, quote, sep;
+  __m256i x;
+
+  for (; pos + 32 <= end; pos += 32){
+    x = _mm256_loadu_si256((const __m256i *) (data + pos));
+    alnum = alnum_avx2(x);
+    quote = (unsigned int)
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\'')));
+    sep = ~(alnum | quote);
+    if (sep != 0){
+      sep &= -sep;
+      *apostrophe = (quote & (sep - 1)) != 0;
+      return pos + __builtin_ctz(sep);
+    }
+    if (quote != 0){
+      pos = span_scalar(data, pos, end, apostrophe);
+      *apostrophe = 1;
+      return pos;
+    }
+  }
+  return span_sse2(data, pos, end, apostrophe);
+}
+#endif
+
+/**
+ * Function: fold_word
+ * Purpose: copies a word of only letters and digits into the buffer in
+ * lowercase. Setting bit 0x20 lowercases a letter and leaves a digit as
+ * it is, so a whole vector is folded with one OR. Whole vectors may
+ * store past the word, which the spare room in the buffer allows for.
+ *
+ * @param tok the tokenizer.
+ * @param start the start of the word.
+ * @param n the length of the word, at most MAX_WORD.
+ */
+static void fold_word(tokenizer tok, size_t start, int n){
+  const unsigned char *data = tok->data + start;
+  int i = 0;
+
+#ifdef VECTOR_SCAN
+  __m128i x;
+
+  for (; i < n && start + i + 16 <= tok->end; i += 16){
+    x = _mm_loadu_si128((const __m128i *) (data + i));
+    _mm_storeu_si128((__m128i *) (tok->word + i),
+                     _mm_or_si128(x, _mm_set1_epi8(0x20)));
+  }
+#endif
+  for (; i < n; i++){
+    tok->word[i] = data[i] | 0x20;
+  }
+  tok->word[n] = '\0';
+}
+
+/**
+ * Function: tokenizer_alloc
+ * Purpose: creates a tokenizer with no input.
+ *
+ * @return the new tokenizer.
+ */
+static tokenizer tokenizer_alloc(void){
+  tokenizer tok = emalloc(sizeof *tok);
+
+  tok->data = NULL;
+  tok->pos = 0;
+  tok->end = 0;
+  tok->map = NULL;
+  tok->map_len = 0;
+  tok->buffer = NULL;
+  tok->fd = -1;
+  tok->skip = skip_scalar;
+  tok->span = span_scalar;
+#ifdef VECTOR_SCAN
+  tok->skip = skip_sse2;
+  tok->span = span_sse2;
+  if (__builtin_cpu_supports("avx2")){
+    tok->skip = skip_avx2;
+    tok->span = span_avx2;
+  }
+#endif
+  return tok;
+}
+
+/**
+ * Function: tokenizer_new
+ * Purpose: creates a tokenizer reading the rest of a stream. A regular
+ * file is mapped into memory and scanned in place, and anything else,
+ * such as a pipe, is read a large block at a time. The tokenizer reads
+ * the file itself from then on, not through the stream.
+ *
+ * @param stream the stream to read words from.
+ * @return the new tokenizer.
+ */
+tokenizer tokenizer_new(FILE *stream){
+  tokenizer tok = tokenizer_alloc();
+  struct stat st;
+  long offset = ftell(stream);
+  void *map;
+
+  tok->fd = fileno(stream);
+  if (fstat(tok->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+      && offset >= 0 && offset < st.st_size){
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, tok->fd, 0);
+    if (map != MAP_FAILED){
+      posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+      tok->map = map;
+      tok->map_len = st.st_size;
+      tok->data = map;
+      tok->pos = offset;
+      tok->end = st.st_size;
+      tok->fd = -1;
+      return tok;
+    }
+  }
+  tok->buffer = emalloc(READ_SIZE);
+  tok->data = tok->buffer;
+  return tok;
+}
+
+/**
+ * Function: tokenizer_new_memory
+ * Purpose: creates a tokenizer over text already in memory, which must
+ * stay there until the tokenizer is freed.
+ *
+ * @param text the text to read words from.
+ * @param len the length of the text.
+ * @return the new tokenizer.
+ */
+tokenizer tokenizer_new_memory(const char *text, size_t len){
+  tokenizer tok = tokenizer_alloc();
+
+  tok->data = (const unsigned char *) text;
+  tok->end = len;
+  return tok;
+}
+
+/**
+ * Function: tokenizer_refill
+ * Purpose: reads the next block of input once the last is used up.
+ *
+ * @param tok the tokenizer.
+ * @return 1 if there is more input, 0 at the end of the input.
+ */
+static int tokenizer_refill(tokenizer tok){
+  ssize_t got;
+
+  if (tok->fd < 0){
+    return 0;
+  }
+  do {
+    got = read(tok->fd, tok->buffer, READ_SIZE);
+  } while (got < 0 && errno == EINTR);
+  if (got <= 0){
+    tok->fd = -1;
+    return 0;
+  }
+  tok->pos = 0;
+  tok->end = got;
+  return 1;
+}
+
+/**
+ * Function: tokenizer_next
+ * Purpose: reads the next word, giving the same words as getword with a
+ * 256 byte buffer. A word is a run of letters and digits, folded to
+ * lowercase, and apostrophes inside it are dropped. A word is at most
+ * MAX_WORD long and the rest of a longer run is the next word.
+ *
+ * The bounds of a word are found a vector at a time. A word without
+ * apostrophes, which is not cut off by the end of a block still to be
+ * refilled, is folded straight into the buffer; any other word is read
+ * a byte at a time.
+ *
+ * @param tok the tokenizer.
+ * @param word set to the word, which stays valid until the next call.
+ * @return the length of the word, or EOF at the end of the input.
+ */
+int tokenizer_next(tokenizer tok, char **word){
+  const unsigned char *data = tok->data;
+  unsigned char c = APOSTROPHE;
+  size_t start, stop, limit;
+  int n = 0, apostrophe;
+
+  for (;;){
+    tok->pos = tok->skip(data, tok->pos, tok->end);
+    if (tok->pos < tok->end){
+      break;
+    }
+    if (!tokenizer_refill(tok)){
+      return EOF;
+    }
+  }
+
+  start = tok->pos;
+  limit = tok->end - start > MAX_WORD ? start + MAX_WORD + 1 : tok->end;
+  stop = tok->span(data, start, limit, &apostrophe);
+  if (!apostrophe && stop - start > MAX_WORD){
+    /* The first MAX_WORD bytes of a longer run are a word, and the
+       rest is left for the next call. */
+    fold_word(tok, start, MAX_WORD);
+    tok->pos = start + MAX_WORD;
+    *word = tok->word;
+    return MAX_WORD;
+  }
+  if (!apostrophe && (stop < tok->end || tok->fd < 0)){
+    n = (int) (stop - start);
+    fold_word(tok, start, n);
+    tok->pos = stop < tok->end ? stop + 1 : stop;
+    *word = tok->word;
+    return n;
+  }
+
+  while (c != SEPARATOR){
+    while (tok->pos < tok->end && n < MAX_WORD){
+      c = byte_class[data[tok->pos++]];
+      if (c > APOSTROPHE){
+        tok->word[n++] = c;
+      } else if (c == SEPARATOR){
+        break;
+      }
+    }
+    if (n == MAX_WORD || (c != SEPARATOR && !tokenizer_refill(tok))){
+      break;
+    }
+  }
+  tok->word[n] = '\0';
+  *word = tok->word;
+  return n;
+}
+
+/**
+ * Function: tokenizer_free
+ * Purpose: frees all the memory allocated to the tokenizer, unmapping
+ * its file if it has one.
+ *
+ * @param tok the tokenizer.
+ */
+void tokenizer_free(tokenizer tok){
+
+  if (tok->map != NULL){
+    munmap(tok->map, tok->map_len);
+  }
+  free(tok->buffer);
+  free(tok);
+}
@@ -0,0 +1,28 @@
+/**
+ * File: tokenizer.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef TOKENIZER_H_
+#define TOKENIZER_H_
+
+#include <stdio.h>
+
+/**
+ * Struct: tokenizerrec
+ * Purpose: defines a struct type of tokenizerrec to split input into
+ * words the same way getword does.
+ */
+typedef struct tokenizerrec *tokenizer;
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the tokenizer.c file,
+ * based on their signatures.
+ */
+extern void tokenizer_free(tokenizer tok);
+extern tokenizer tokenizer_new(FILE *stream);
+extern tokenizer tokenizer_new_memory(const char *text, size_t len);
+extern int tokenizer_next(tokenizer tok, char **word);
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * File: topk.c
+ * @author: Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mylib.h"
+#include "topk.h"
+
+#define EMPTY -1
+
+/**
+ * Struct: topk_entry
+ * Purpose: declares the variables for one of the words being kept, with
+ * the slot of the index which points at it.
+ */
+struct topk_entry {
+  char *word;
+  uint64_t hash;
+  int count;
+  int slot;
+};
+
+/**
+ * Struct: topkrec
+ * Purpose: declares the variables for the k most frequent words. The
+ * words are kept in a min-heap on their counts, ties going to the word
+ * last in alphabetical order, so the word to drop first is always at
+ * the root, ready to be replaced. The index is a small
+ * linear probing hash table holding the heap position of each word, so
+ * a word already being kept is found without searching the heap.
+ */
+struct topkrec {
+  int k;
+  int size;
+  struct topk_entry *heap;
+  int *index;
+  int capacity;
+};
+
+/**
+ * Function: topk_find
+ * Purpose: finds the slot of the index for a word.
+ *
+ * @param q the top words.
+ * @param word the word.
+ * @param hash the hash of the word.
+ * @return the slot pointing at the word, or the empty slot where it
+ * would go if it is not being kept.
+ */
+static int topk_find(topk q, char *word, uint64_t hash){
+  int mask = q->capacity - 1, j = (int) (hash & mask);
+  struct topk_entry *e;
+
+  while (q->index[j] != EMPTY){
+    e = &q->heap[q->index[j]];
+    if (e->hash == hash && strcmp(e->word, word) == 0){
+      return j;
+    }
+    j = (j + 1) & mask;
+  }
+  return j;
+}
+
+/**
+ * Function: topk_unindex
+ * Purpose: empties a slot of the index, shifting back any later slots of
+ * the same run which could no longer be found past the gap.
+ *
+ * @param q the top words.
+ * @param j the slot to empty.
+ */
+static void topk_unindex(topk q, int j){
+  int mask = q->capacity - 1, i = j, home;
+
+  q->index[j] = EMPTY;
+  for (j = (j + 1) & mask; q->index[j] != EMPTY; j = (j + 1) & mask){
+    home = (int) (q->heap[q->index[j]].hash & mask);
+    /* The word at j can fill the gap unless its home slot lies
+       cyclically after the gap and no later than j. */
+    if (i <= j ? (home <= i || home > j) : (home <= i && home > j)){
+      q->index[i] = q->index[j];
+      q->heap[q->index[i]].slot = i;
+      q->index[j] = EMPTY;
+      i = j;
+    }
+  }
+}
+
+/**
+ * Function: topk_swap
+ * Purpose: swaps two words of the heap, keeping the index pointing at
+ * both.
+ *
+ * @param q the top words.
+ * @param a the position of one word.
+ * @param b the position of the other.
+ */
+static void topk_swap(topk q, int a, int b){
+  struct topk_entry temp = q->heap[a];
+
+  q->heap[a] = q->heap[b];
+  q->heap[b] = temp;
+  q->index[q->heap[a].slot] = a;
+  q->index[q->heap[b].slot] = b;
+}
+
+/**
+ * Function: topk_below
+ * Purpose: tells whether a word ranks below another, having a lower
+ * count or the same count and coming later alphabetically.
+ *
+ * @param count the count of the first word.
+ * @param word the first word.
+ * @param e the entry of the second word.
+ * @return 1 if the first word ranks below the second, otherwise 0.
+ */
+static int topk_below(int count, const char *word,
+                      const struct topk_entry *e){
+  if (count != e->count){
+    return count < e->count;
+  }
+  return strcmp(word, e->word) > 0;
+}
+
+/**
+ * Function: topk_sift_down
+ * Purpose: moves a word down the heap past any child ranking below it.
+ *
+ * @param q the top words.
+ * @param i the position of the word.
+ */
+static void topk_sift_down(topk q, int i){
+  struct topk_entry *h = q->heap;
+  int child;
+
+  while ((child = 2 * i + 1) < q->size){
+    if (child + 1 < q->size
+        && topk_below(h[child + 1].count, h[child + 1].word, &h[child])){
+      child++;
+    }
+    if (!topk_below(h[child].count, h[child].word, &h[i])){
+      break;
+    }
+    topk_swap(q, i, child);
+    i = child;
+  }
+}
+
+/**
+ * Function: topk_sift_up
+ * Purpose: moves a word up the heap past any parent ranking above it.
+ *
+ * @param q the top words.
+ * @param i the position of the word.
+ */
+static void topk_sift_up(topk q, int i){
+  struct topk_entry *h = q->heap;
+
+  while (i > 0 && topk_below(h[i].count, h[i].word, &h[(i - 1) / 2])){
+    topk_swap(q, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+/**
+ * Function: topk_place
+ * Purpose: starts keeping a word which is not being kept, in a free
+ * place in the heap or else in place of the least frequent word.
+ *
+ * @param q the top words.
+ * @param word the word.
+ * @param hash the hash of the word.
+ * @param slot the empty slot of the index for the word.
+ * @param count the count to give the word.
+ */
+static void topk_place(topk q, char *word, uint64_t hash, int slot,
+                       int count){
+  int pos = q->size;
+
+  if (q->size < q->k){
+    q->size++;
+  } else {
+    /* Emptying the slot of the old word can move the empty slot
+       found for the new one. */
+    pos = 0;
+    topk_unindex(q, q->heap[0].slot);
+    free(q->heap[0].word);
+    slot = topk_find(q, word, hash);
+  }
+  q->heap[pos].word = emalloc(strlen(word) + 1);
+  strcpy(q->heap[pos].word, word);
+  q->heap[pos].hash = hash;
+  q->heap[pos].count = count;
+  q->heap[pos].slot = slot;
+  q->index[slot] = pos;
+  if (pos == 0){
+    topk_sift_down(q, pos);
+  } else {
+    topk_sift_up(q, pos);
+  }
+}
+
+/**
+ * Function: topk_update
+ * Purpose: gives the top words the current frequency of a word, for
+ * exact counts kept by another data structure. A word is only kept while
+ * it is among the k most frequent given so far, words with the same
+ * count ranked alphabetically, so the words kept do not depend on the
+ * order they are given in.
+ *
+ * @param q the top words.
+ * @param word the word.
+ * @param freq the frequency of the word.
+ */
+void topk_update(topk q, char *word, int freq){
+  uint64_t hash = hash_xx64(word, strlen(word), 0);
+  int slot = topk_find(q, word, hash), pos, old;
+  if (q->index[slot] != EMPTY){
+    pos = q->index[slot];
+    old = q->heap[pos].count;
+    q->heap[pos].count = freq;
+    if (freq >= old){
+      topk_sift_down(q, pos);
+    } else {
+      topk_sift_up(q, pos);
+    }
+  } else if (q->size < q->k || !topk_below(freq, word, &q->heap[0])){
+    topk_place(q, word, hash, slot, freq);
+  }
+}
+
+/**
+ * Function: topk_add
+ * Purpose: counts one more of a word in a stream using Space-Saving,
+ * which never keeps more than k words. A new word takes the place of
+ * the least frequent word and one more than its count, so the count of
+ * a word is never too low, and is too high by at most the count it took
+ * over. Any word seen more often than the least frequent count is sure
+ * to be kept.
+ *
+ * @param q the top words.
+ * @param word the word.
+ */
+void topk_add(topk q, char *word){
+  uint64_t hash = hash_xx64(word, strlen(word), 0);
+  int slot = topk_find(q, word, hash), pos;
+
+  if (q->index[slot] != EMPTY){
+    pos = q->index[slot];
+    q->heap[pos].count++;
+    topk_sift_down(q, pos);
+  } else {
+    topk_place(q, word, hash, slot,
+               q->size < q->k ? 1 : q->heap[0].count + 1);
+  }
+}
+
+/**
+ * Function: topk_compare
+ * Purpose: orders words by decreasing count, and then alphabetically.
+ *
+ * @param a a pointer to a pointer to the first entry.
+ * @param b a pointer to a pointer to the second entry.
+ * @return less than, equal to or greater than 0 as the first entry goes
+ * before, with or after the second.
+ */
+static int topk_compare(const void *a, const void *b){
+  const struct topk_entry *x = *(struct topk_entry * const *) a;
+  const struct topk_entry *y = *(struct topk_entry * const *) b;
+
+  if (x->count != y->count){
+    return x->count > y->count ? -1 : 1;
+  }
+  return strcmp(x->word, y->word);
+}
+
+/**
+ * Function: topk_print
+ * Purpose: performs a function on the words being kept, from the most
+ * frequent to the least.
+ *
+ * @param q the top words.
+ * @param f another function passed in with parameters freq and str.
+ */
+void topk_print(topk q, void f(int freq, char *str)){
+  struct topk_entry **sorted = emalloc((q->size + 1) * sizeof sorted[0]);
+  int i;
+
+  for (i = 0; i < q->size; i++){
+    sorted[i] = &q->heap[i];
+  }
+  qsort(sorted, q->size, sizeof sorted[0], topk_compare);
+  for (i = 0; i < q->size; i++){
+    f(sorted[i]->count, sorted[i]->word);
+  }
+  free(sorted);
+}
+
+/**
+ * Function: topk_free
+ * Purpose: frees all the memory allocated to the top words.
+ *
+ * @param q the top words.
+ */
+void topk_free(topk q){
+  int i;
+
+  for (i = 0; i < q->size; i++){
+    free(q->heap[i].word);
+  }
+  free(q->heap);
+  free(q->index);
+  free(q);
+}
+
+/**
+ * Function: topk_new
+ * Purpose: creates an empty set of top words.
+ *
+ * @param k the number of words to keep, at least 1.
+ * @return the new top words.
+ */
+topk topk_new(int k){
+  topk q = emalloc(sizeof *q);
+  int i;
+
+  q->k = k;
+  q->size = 0;
+  q->heap = emalloc(k * sizeof q->heap[0]);
+  for (q->capacity = 4; q->capacity < 2 * k; q->capacity *= 2)
+    ;
+  q->index = emalloc(q->capacity * sizeof q->index[0]);
+  for (i = 0; i < q->capacity; i++){
+    q->index[i] = EMPTY;
+  }
+  return q;
+}
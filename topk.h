@@ -0,0 +1,27 @@
+/**
+ * File: topk.h
+ * @author Vivian Breda, Josh King, Abinaya Saravanapavan.
+ */
+
+#ifndef TOPK_H_
+#define TOPK_H_
+
+/**
+ * Struct: topkrec
+ * Purpose: defines a struct type of topkrec to hold the k most frequent
+ * words seen so far.
+ */
+typedef struct topkrec *topk;
+
+/**
+ * Prototypes
+ * Purpose: specifies functions to be implemented in the topk.c file, based on
+ * their signatures.
+ */
+extern void topk_add(topk q, char *word);
+extern void topk_free(topk q);
+extern topk topk_new(int k);
+extern void topk_print(topk q, void f(int freq, char *str));
+extern void topk_update(topk q, char *word, int freq);
+
+#endif
@@ -8,68 +8,331 @@
 #include <string.h>
 #include <stdio.h>
 #include "mylib.h"
+#include "snapshot.h"
 #include "tree.h"
 
-#define IS_BLACK(x) ((NULL == (x)) || (BLACK == (x)->colour))
-#define IS_RED(x) ((NULL != (x)) && (RED == (x)->colour))
+/* Nodes are numbered from 1 in the node pool of their tree, so 0 stands
+   for no node. The top bit of left holds the colour of a node, and the
+   top bit of right is set when its key is kept in the arena. */
+#define NIL 0
+#define HIGH_BIT 0x80000000u
+#define LEFT(t, n) ((t)->nodes[n].left & ~HIGH_BIT)
+#define RIGHT(t, n) ((t)->nodes[n].right & ~HIGH_BIT)
+#define IS_RED(t, n) ((NIL != (n)) && ((t)->nodes[n].left & HIGH_BIT))
+#define IS_BLACK(t, n) (!IS_RED(t, n))
 
-static tree_t tree_type;
+/* Keys shorter than INLINE_KEY are stored in the node itself, which
+   with the cached prefix of the key keeps a node at 32 bytes, two to a
+   cache line. */
+#define INLINE_KEY 12
 
-static tree root_node = NULL;
+/* The bytes of a prefix after the end of a short key are 0, so a prefix
+   whose last byte is 0 is the whole key. */
+#define PREFIX_BYTES 8
+
+/* Every B-tree node but the root holds between BTREE_DEGREE - 1 and
+   BTREE_MAX keys, so a node takes up about five cache lines. */
+#define BTREE_DEGREE 8
+#define BTREE_MAX (2 * BTREE_DEGREE - 1)
 
 /**
  * Struct: tree_node
- * Purpose: declares the variables for the tree node.
+ * Purpose: declares the variables for the tree node. Longer keys are
+ * kept in the arena of the tree, with a pointer to them in key. The
+ * prefix holds the first bytes of the key as a big-endian number, so
+ * comparing prefixes as numbers orders keys the same way as strcmp.
  */
+typedef uint32_t node;
+
 struct tree_node {
-  char *key;
-  tree_colour colour;
-  tree left;
-  tree right;
+  uint64_t prefix;
+  node left;
+  node right;
   int frequency;
+  char key[INLINE_KEY];
+};
+
+/**
+ * Struct: btree_node
+ * Purpose: declares the variables for a B-tree node, which holds several
+ * keys in sorted order and, unless it is a leaf, one more child than
+ * keys. The prefix of each key is kept in the node as in a tree node,
+ * so a search only follows a key pointer where prefixes tie.
+ */
+typedef struct btree_node *bnode;
+
+struct btree_node {
+  int num_keys;
+  int leaf;
+  uint64_t prefixes[BTREE_MAX];
+  char *keys[BTREE_MAX];
+  int frequencies[BTREE_MAX];
+  bnode children[BTREE_MAX + 1];
+};
+
+/**
+ * Struct: treerec
+ * Purpose: declares the variables for a tree. Each tree owns its root,
+ * its type, the pool holding its nodes, the arena holding its long keys
+ * and the stack used to walk it, so separate trees can be used at the
+ * same time. Removed nodes are kept on a free list through their left
+ * index for the next insert. A frozen tree also has a copy of its keys
+ * and their frequencies in Eytzinger order, from 1 to num_frozen, which
+ * searches use until the tree next changes. The copies lie end to end
+ * in one block and are found by their offsets into it, so the same
+ * layout can be saved to a file and searched where it is mapped, as
+ * image.
+ */
+struct treerec {
+  node root;
+  struct tree_node *nodes;
+  node num_nodes;
+  node pool_size;
+  node free_nodes;
+  bnode broot;
+  tree_t type;
+  arena key_arena;
+  node *stack;
+  int stack_size;
+  char *frozen;
+  uint64_t *frozen_offsets;
+  uint64_t *frozen_prefixes;
+  int32_t *frozen_frequencies;
+  uint64_t frozen_len;
+  int num_frozen;
+  void *image;
+  size_t image_len;
+};
+
+/**
+ * Struct: tree_image
+ * Purpose: declares the header of a saved frozen tree, giving the
+ * offsets of its arrays from the start of the file.
+ */
+struct tree_image {
+  int32_t type;
+  int32_t num_frozen;
+  uint64_t prefixes;
+  uint64_t offsets;
+  uint64_t frequencies;
+  uint64_t keys;
+  uint64_t keys_len;
 };
 
+/* Names a saved frozen tree, and the version of its layout. */
+#define TREE_MAGIC "asgnTR03"
+
 /**
- * Function: root_fix
- * Purpose: changes the root colour to black. 
+ * Macro: FROZEN_KEY
+ * Purpose: finds the key at position k of the frozen copy of a tree.
+ */
+#define FROZEN_KEY(t, k) ((t)->frozen + (t)->frozen_offsets[k])
+
+/**
+ * Function: tree_stack
+ * Purpose: makes sure the stack of a tree can hold at least n nodes.
  *
  * @param t is the tree.
- * @return t the fixed tree. 
+ * @param n the number of nodes the stack has to hold.
+ * @return the stack.
  */
-tree root_fix(tree t){
+static node *tree_stack(tree t, int n){
 
-  t->colour = BLACK;
-  return t;
+  if (n > t->stack_size){
+    while (n > t->stack_size){
+      t->stack_size *= 2;
+    }
+    t->stack = erealloc(t->stack, t->stack_size * sizeof t->stack[0]);
+  }
+  return t->stack;
 }
 
 /**
- * Function: right_rotate
- * Purpose: rotates the tree branches from the left to the right
- * around the root of given subtree. 
+ * Function: set_left
+ * Purpose: sets the left child of a node, keeping its colour.
  *
  * @param t is the tree.
- * @return t the rotated tree. 
+ * @param n is the node.
+ * @param child the new left child.
  */
-static tree right_rotate(tree t){
-  tree temp;
-  int root_flag = 0;
+static void set_left(tree t, node n, node child){
+  t->nodes[n].left = (t->nodes[n].left & HIGH_BIT) | child;
+}
 
-    
-  if (t == root_node){
-    root_flag = 1;
+/**
+ * Function: set_right
+ * Purpose: sets the right child of a node, keeping its key flag.
+ *
+ * @param t is the tree.
+ * @param n is the node.
+ * @param child the new right child.
+ */
+static void set_right(tree t, node n, node child){
+  t->nodes[n].right = (t->nodes[n].right & HIGH_BIT) | child;
+}
+
+/**
+ * Function: set_colour
+ * Purpose: sets the colour of a node.
+ *
+ * @param t is the tree.
+ * @param n is the node.
+ * @param colour the new colour.
+ */
+static void set_colour(tree t, node n, tree_colour colour){
+
+  if (colour == RED){
+    t->nodes[n].left |= HIGH_BIT;
+  } else {
+    t->nodes[n].left &= ~HIGH_BIT;
   }
-  temp = t;
+}
+
+/**
+ * Function: node_key
+ * Purpose: finds the key of a node, inline or in the arena.
+ *
+ * @param t is the tree.
+ * @param n is the node.
+ * @return the key.
+ */
+static char *node_key(tree t, node n){
+  char *key;
 
-  t = t->left;
-  temp->left = t->right;
+  if (t->nodes[n].right & HIGH_BIT){
+    memcpy(&key, t->nodes[n].key, sizeof key);
+    return key;
+  }
+  return t->nodes[n].key;
+}
 
-  t->right = temp;
+/**
+ * Function: key_prefix
+ * Purpose: packs the first bytes of a string into a big-endian number.
+ *
+ * @param str the string.
+ * @return the prefix of the string.
+ */
+static uint64_t key_prefix(const char *str){
+  uint64_t prefix = 0;
+  int i;
 
-  if (root_flag == 1){
-    root_node = t;
+  for (i = 0; i < PREFIX_BYTES && str[i] != '\0'; i++){
+    prefix |= (uint64_t) (unsigned char) str[i] << (56 - 8 * i);
   }
+  return prefix;
+}
 
-  return t;
+/**
+ * Function: prefix_compare
+ * Purpose: compares two strings the way strcmp does, by their prefixes
+ * where they differ and by the rest of the strings only where they tie.
+ *
+ * @param prefix_a the prefix of the first string.
+ * @param a the first string.
+ * @param prefix_b the prefix of the second string.
+ * @param b the second string.
+ * @return less than, equal to or greater than 0 as a is less than, equal
+ * to or greater than b.
+ */
+static int prefix_compare(uint64_t prefix_a, const char *a,
+                          uint64_t prefix_b, const char *b){
+
+  if (prefix_a != prefix_b){
+    return prefix_a > prefix_b ? 1 : -1;
+  }
+  if ((prefix_a & 0xff) == 0){
+    return 0;
+  }
+  return strcmp(a + PREFIX_BYTES, b + PREFIX_BYTES);
+}
+
+/**
+ * Function: copy_key
+ * Purpose: gives a node the key and frequency of another node.
+ *
+ * @param t is the tree.
+ * @param to the node to copy to.
+ * @param from the node to copy from.
+ */
+static void copy_key(tree t, node to, node from){
+  t->nodes[to].prefix = t->nodes[from].prefix;
+  memcpy(t->nodes[to].key, t->nodes[from].key, INLINE_KEY);
+  t->nodes[to].right = (t->nodes[from].right & HIGH_BIT) | RIGHT(t, to);
+  t->nodes[to].frequency = t->nodes[from].frequency;
+}
+
+/**
+ * Function: node_new
+ * Purpose: takes a red node with no children from the pool of a tree,
+ * growing the pool if it has no free nodes left.
+ *
+ * @param t is the tree.
+ * @param str the key of the node.
+ * @param freq the frequency of the key.
+ * @return the new node.
+ */
+static node node_new(tree t, char *str, int freq){
+  size_t len = strlen(str);
+  char *key;
+  node n;
+
+  if (t->free_nodes != NIL){
+    n = t->free_nodes;
+    t->free_nodes = t->nodes[n].left;
+  } else {
+    if (t->num_nodes + 1 == t->pool_size){
+      if (t->pool_size >= HIGH_BIT / 2){
+        fprintf(stderr, "Too many tree nodes.\n");
+        exit(EXIT_FAILURE);
+      }
+      t->pool_size *= 2;
+      t->nodes = erealloc(t->nodes, t->pool_size * sizeof t->nodes[0]);
+    }
+    n = ++t->num_nodes;
+  }
+
+  t->nodes[n].left = HIGH_BIT | NIL;
+  t->nodes[n].right = NIL;
+  t->nodes[n].frequency = freq;
+  t->nodes[n].prefix = key_prefix(str);
+  if (len < INLINE_KEY){
+    memcpy(t->nodes[n].key, str, len + 1);
+  } else {
+    key = arena_strdup(t->key_arena, str);
+    memcpy(t->nodes[n].key, &key, sizeof key);
+    t->nodes[n].right |= HIGH_BIT;
+  }
+  return n;
+}
+
+/**
+ * Function: node_release
+ * Purpose: puts a node back on the free list of its tree.
+ *
+ * @param t is the tree.
+ * @param n is the node.
+ */
+static void node_release(tree t, node n){
+  t->nodes[n].left = t->free_nodes;
+  t->free_nodes = n;
+}
+
+/**
+ * Function: right_rotate
+ * Purpose: rotates the tree branches from the left to the right
+ * around the root of given subtree. 
+ *
+ * @param t is the tree.
+ * @param n is the root of the subtree.
+ * @return the new root of the subtree. 
+ */
+static node right_rotate(tree t, node n){
+  node temp = LEFT(t, n);
+
+  set_left(t, n, RIGHT(t, temp));
+  set_right(t, temp, n);
+  return temp;
 }
 
 /**
@@ -78,105 +341,780 @@ static tree right_rotate(tree t){
  * around the root of given subtree.
  *
  * @param t is the tree.
- * @return t the rotated tree. 
+ * @param n is the root of the subtree.
+ * @return the new root of the subtree. 
  */
-static tree left_rotate(tree t){
-  tree  temp;
-  int root_flag = 0;
+static node left_rotate(tree t, node n){
+  node temp = RIGHT(t, n);
 
-  if (t == root_node){
-    root_flag = 1;
+  set_right(t, n, LEFT(t, temp));
+  set_left(t, temp, n);
+  return temp;
+}
+
+/**
+ * Function: relink
+ * Purpose: points the parent of a subtree, or the root of the tree if
+ * the subtree has no parent, at a new root for the subtree.
+ *
+ * @param t is the tree.
+ * @param parent the parent of the subtree, or NIL.
+ * @param old the old root of the subtree.
+ * @param new the new root of the subtree.
+ */
+static void relink(tree t, node parent, node old, node new){
+
+  if (parent == NIL){
+    t->root = new;
+  } else if (LEFT(t, parent) == old){
+    set_left(t, parent, new);
+  } else {
+    set_right(t, parent, new);
   }
-  temp = t;
+}
 
-  t = t->right;
-  temp->right = t->left;
+/**
+ * Function: tree_fix
+ * Purpose: updates the colours of the branches of the tree after a red
+ * node is added, and makes sure the tree is balanced. The nodes on the
+ * path from the root down to the new node are on the stack of the tree,
+ * and the loop only runs while the new node has a red parent.
+ *
+ * @param t is the tree.
+ * @param depth the position of the new node on the stack.
+ */
+static void tree_fix(tree t, int depth){
+  node *path = t->stack;
+  node n, parent, grandparent, uncle;
 
-  t->left = temp;
+  while (depth >= 2 && IS_RED(t, path[depth - 1])){
+    n = path[depth];
+    parent = path[depth - 1];
+    grandparent = path[depth - 2];
+    uncle = LEFT(t, grandparent) == parent
+      ? RIGHT(t, grandparent) : LEFT(t, grandparent);
 
-  if (root_flag == 1){
-    root_node = t;
+    if (IS_RED(t, uncle)){
+      set_colour(t, grandparent, RED);
+      set_colour(t, parent, BLACK);
+      set_colour(t, uncle, BLACK);
+      depth -= 2;
+      continue;
+    }
+
+    if (LEFT(t, grandparent) == parent){
+      if (RIGHT(t, parent) == n){
+        set_left(t, grandparent, left_rotate(t, parent));
+      }
+      n = right_rotate(t, grandparent);
+    } else {
+      if (LEFT(t, parent) == n){
+        set_right(t, grandparent, right_rotate(t, parent));
+      }
+      n = left_rotate(t, grandparent);
+    }
+    set_colour(t, n, BLACK);
+    set_colour(t, grandparent, RED);
+    relink(t, depth >= 3 ? path[depth - 3] : NIL, grandparent, n);
+    break;
   }
-    
-  return t;
+  set_colour(t, t->root, BLACK);
 }
 
 /**
- * Function: tree_fix
- * Purpose: updates the colours of the branches of the tree,
- * and makes sure the tree is balanced. 
+ * Function: btree_node_new
+ * Purpose: creates a new, empty B-tree node.
+ *
+ * @param leaf 1 if the node is a leaf, 0 if it has children.
+ * @return the new node.
+ */
+static bnode btree_node_new(int leaf){
+  bnode b = emalloc(sizeof *b);
+
+  b->num_keys = 0;
+  b->leaf = leaf;
+  return b;
+}
+
+/**
+ * Function: btree_copy_key
+ * Purpose: gives position i of a B-tree node the key, prefix and
+ * frequency at position j of another node, or of the same node.
+ *
+ * @param to the node to copy to.
+ * @param i the position to copy to.
+ * @param from the node to copy from.
+ * @param j the position to copy from.
+ */
+static void btree_copy_key(bnode to, int i, bnode from, int j){
+  to->prefixes[i] = from->prefixes[j];
+  to->keys[i] = from->keys[j];
+  to->frequencies[i] = from->frequencies[j];
+}
+
+/**
+ * Function: btree_find
+ * Purpose: binary searches the keys of a B-tree node for a string,
+ * comparing prefixes before keys.
+ *
+ * @param b the node to search.
+ * @param prefix the prefix of the string.
+ * @param str the string to search for.
+ * @param found set to 1 if the string is a key of the node, 0 if not.
+ * @return the position of the first key which is not less than str, so
+ * the index of the child to search next if str was not found.
+ */
+static int btree_find(bnode b, uint64_t prefix, char *str, int *found){
+  int low = 0, high = b->num_keys, mid, cmp;
+
+  while (low < high){
+    mid = (low + high) / 2;
+    cmp = prefix_compare(prefix, str, b->prefixes[mid], b->keys[mid]);
+    if (cmp == 0){
+      *found = 1;
+      return mid;
+    } else if (cmp > 0){
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  *found = 0;
+  return low;
+}
+
+/**
+ * Function: btree_split_child
+ * Purpose: splits the full child i of a B-tree node in two around its
+ * middle key, which moves up into the node.
+ *
+ * @param b the node whose child is split, which must not be full.
+ * @param i the index of the child to split.
+ */
+static void btree_split_child(bnode b, int i){
+  bnode y = b->children[i];
+  bnode z = btree_node_new(y->leaf);
+  int j;
+
+  z->num_keys = BTREE_DEGREE - 1;
+  for (j = 0; j < BTREE_DEGREE - 1; j++){
+    btree_copy_key(z, j, y, j + BTREE_DEGREE);
+  }
+  for (j = 0; !y->leaf && j < BTREE_DEGREE; j++){
+    z->children[j] = y->children[j + BTREE_DEGREE];
+  }
+  y->num_keys = BTREE_DEGREE - 1;
+
+  for (j = b->num_keys; j > i; j--){
+    btree_copy_key(b, j, b, j - 1);
+    b->children[j + 1] = b->children[j];
+  }
+  btree_copy_key(b, i, y, BTREE_DEGREE - 1);
+  b->children[i + 1] = z;
+  b->num_keys++;
+}
+
+/**
+ * Function: btree_search
+ * Purpose: finds the node and position holding a string in a B-tree.
+ *
+ * @param b the root of the B-tree.
+ * @param str the string to search for.
+ * @param i set to the position of the string in the node returned.
+ * @return the node holding the string, or NULL if it is not there.
+ */
+static bnode btree_search(bnode b, char *str, int *i){
+  uint64_t prefix = key_prefix(str);
+  int found;
+
+  while (b != NULL){
+    *i = btree_find(b, prefix, str, &found);
+    if (found){
+      return b;
+    }
+    b = b->leaf ? NULL : b->children[*i];
+  }
+  return NULL;
+}
+
+/**
+ * Function: btree_insert
+ * Purpose: inserts a string into a B-tree with the given frequency, or
+ * adds the frequency to it if it is already there. New keys go in on the
+ * way down a single path, splitting any full node on it first so there
+ * is always room for the key which moves up from a split.
  *
  * @param t is the tree.
- * @return t the fixed tree. 
+ * @param str is a pointer to the string to be inserted.
+ * @param freq how many times the string is being inserted.
+ * @return the frequency of the string afterwards.
  */
-static tree tree_fix(tree t){
-    
-  if (IS_RED(t->left) && IS_RED(t->left->left)){
-    if (IS_RED(t->right)){
-      t->colour = RED;
-      t->left->colour = BLACK;
-      t->right->colour = BLACK;
-    } else if (IS_BLACK(t->right)){
-      t = right_rotate(t);
-      t->colour = BLACK;
-      t->right->colour = RED;
-    }
-  } else if (IS_RED(t->left) && IS_RED(t->left->right)){
-    if (IS_RED(t->right)){
-      t->colour = RED;
-      t->left->colour = BLACK;
-      t->right->colour = BLACK;
-    } else if (IS_BLACK(t->right)){
-      t->left = left_rotate(t->left);
-      t = right_rotate(t);
-      t->colour = BLACK;
-      t->right->colour = RED;
-    }
-  } else if (IS_RED(t->right) && IS_RED(t->right->left)){
-    if (IS_RED(t->left)){
-      t->colour = RED;
-      t->left->colour = BLACK;
-      t->right->colour = BLACK;
-    } else if (IS_BLACK(t->left)){
-      t->right = right_rotate(t->right);
-      t = left_rotate(t);
-      t->colour = BLACK;
-      t->left->colour = RED;
-    }
-  } else if (IS_RED(t->right) && IS_RED(t->right->right)){
-    if (IS_RED(t->left)){
-      t->colour = RED;
-      t->left->colour = BLACK;
-      t->right->colour = BLACK;
-    } else if (IS_BLACK(t->left)){ 
-      t = left_rotate(t);
-      t->colour = BLACK;
-      t->left->colour = RED;
+static int btree_insert(tree t, char *str, int freq){
+  uint64_t prefix = key_prefix(str);
+  int i, j, found;
+  bnode b = btree_search(t->broot, str, &i);
+
+  if (b != NULL){
+    b->frequencies[i] += freq;
+    return b->frequencies[i];
+  }
+
+  if (t->broot == NULL){
+    t->broot = btree_node_new(1);
+  } else if (t->broot->num_keys == BTREE_MAX){
+    b = btree_node_new(0);
+    b->children[0] = t->broot;
+    t->broot = b;
+    btree_split_child(b, 0);
+  }
+
+  for (b = t->broot; !b->leaf; b = b->children[i]){
+    i = btree_find(b, prefix, str, &found);
+    if (b->children[i]->num_keys == BTREE_MAX){
+      btree_split_child(b, i);
+      if (prefix_compare(prefix, str, b->prefixes[i], b->keys[i]) > 0){
+        i++;
+      }
     }
   }
-    
-  root_node = root_fix(root_node);
+
+  i = btree_find(b, prefix, str, &found);
+  for (j = b->num_keys; j > i; j--){
+    btree_copy_key(b, j, b, j - 1);
+  }
+  b->prefixes[i] = prefix;
+  b->keys[i] = arena_strdup(t->key_arena, str);
+  b->frequencies[i] = freq;
+  b->num_keys++;
+  return freq;
+}
+
+/**
+ * Function: btree_merge
+ * Purpose: merges child i + 1 of a B-tree node and the key between them
+ * into child i. Both children must have BTREE_DEGREE - 1 keys.
+ *
+ * @param b the node whose children are merged.
+ * @param i the index of the left child.
+ */
+static void btree_merge(bnode b, int i){
+  bnode y = b->children[i];
+  bnode z = b->children[i + 1];
+  int j;
+
+  btree_copy_key(y, y->num_keys, b, i);
+  for (j = 0; j < z->num_keys; j++){
+    btree_copy_key(y, y->num_keys + 1 + j, z, j);
+  }
+  for (j = 0; !y->leaf && j <= z->num_keys; j++){
+    y->children[y->num_keys + 1 + j] = z->children[j];
+  }
+  y->num_keys += z->num_keys + 1;
+
+  for (j = i; j < b->num_keys - 1; j++){
+    btree_copy_key(b, j, b, j + 1);
+    b->children[j + 1] = b->children[j + 2];
+  }
+  b->num_keys--;
+  free(z);
+}
+
+/**
+ * Function: btree_fill_child
+ * Purpose: makes sure child i of a B-tree node has more than the minimum
+ * number of keys before a removal goes down into it, by borrowing a key
+ * through the node from a sibling or merging with one.
+ *
+ * @param b the node whose child is filled.
+ * @param i the index of the child.
+ * @return the child to go down into, which moves left after a merge with
+ * its left sibling.
+ */
+static bnode btree_fill_child(bnode b, int i){
+  bnode y = b->children[i], s;
+  int j;
+
+  if (y->num_keys >= BTREE_DEGREE){
+    return y;
+  }
+  if (i > 0 && b->children[i - 1]->num_keys >= BTREE_DEGREE){
+    s = b->children[i - 1];
+    for (j = y->num_keys; j > 0; j--){
+      btree_copy_key(y, j, y, j - 1);
+    }
+    for (j = y->num_keys + 1; !y->leaf && j > 0; j--){
+      y->children[j] = y->children[j - 1];
+    }
+    btree_copy_key(y, 0, b, i - 1);
+    y->children[0] = s->children[s->num_keys];
+    btree_copy_key(b, i - 1, s, s->num_keys - 1);
+    s->num_keys--;
+    y->num_keys++;
+  } else if (i < b->num_keys
+             && b->children[i + 1]->num_keys >= BTREE_DEGREE){
+    s = b->children[i + 1];
+    btree_copy_key(y, y->num_keys, b, i);
+    y->children[y->num_keys + 1] = s->children[0];
+    y->num_keys++;
+    btree_copy_key(b, i, s, 0);
+    for (j = 0; j < s->num_keys - 1; j++){
+      btree_copy_key(s, j, s, j + 1);
+    }
+    for (j = 0; !s->leaf && j < s->num_keys; j++){
+      s->children[j] = s->children[j + 1];
+    }
+    s->num_keys--;
+  } else if (i < b->num_keys){
+    btree_merge(b, i);
+  } else {
+    btree_merge(b, i - 1);
+    y = b->children[i - 1];
+  }
+  return y;
+}
+
+/**
+ * Function: btree_remove
+ * Purpose: removes a string from a B-tree on the way down a single path.
+ * Every node gone down into is first given more than the minimum number
+ * of keys, so a key can always be taken out of it. A key in an inner
+ * node is replaced by the one before or after it in order, which is then
+ * removed from its leaf instead.
+ *
+ * @param t is the tree.
+ * @param str is a pointer to the string to be removed.
+ * @return the frequency the string had, or 0 if it was not in the tree.
+ */
+static int btree_remove(tree t, char *str){
+  bnode b = t->broot, leaf;
+  uint64_t prefix = key_prefix(str);
+  int i, j, found, freq = 0;
+
+  while (b != NULL){
+    i = btree_find(b, prefix, str, &found);
+    if (found && freq == 0){
+      freq = b->frequencies[i];
+    }
+    if (found && b->leaf){
+      for (j = i; j < b->num_keys - 1; j++){
+        btree_copy_key(b, j, b, j + 1);
+      }
+      b->num_keys--;
+      break;
+    } else if (b->leaf){
+      break;
+    } else if (found && b->children[i]->num_keys >= BTREE_DEGREE){
+      for (leaf = b->children[i]; !leaf->leaf;
+           leaf = leaf->children[leaf->num_keys])
+        ;
+      btree_copy_key(b, i, leaf, leaf->num_keys - 1);
+      prefix = b->prefixes[i];
+      str = b->keys[i];
+      b = b->children[i];
+      continue;
+    } else if (found && b->children[i + 1]->num_keys >= BTREE_DEGREE){
+      for (leaf = b->children[i + 1]; !leaf->leaf;
+           leaf = leaf->children[0])
+        ;
+      btree_copy_key(b, i, leaf, 0);
+      prefix = b->prefixes[i];
+      str = b->keys[i];
+      b = b->children[i + 1];
+      continue;
+    } else if (found){
+      btree_merge(b, i);
+      leaf = b->children[i];
+    } else {
+      leaf = btree_fill_child(b, i);
+    }
+    if (b == t->broot && b->num_keys == 0){
+      t->broot = leaf;
+      free(b);
+    }
+    b = leaf;
+  }
+
+  if (t->broot != NULL && t->broot->num_keys == 0){
+    free(t->broot);
+    t->broot = NULL;
+  }
+  return freq;
+}
+
+/**
+ * Function: btree_inorder
+ * Purpose: performs a function on the keys of a B-tree in sorted order.
+ *
+ * @param b the root of the B-tree.
+ * @param f another function passed in with parameters freq and str.
+ */
+static void btree_inorder(bnode b, void f(int freq, char *str)){
+  int i;
+
+  for (i = 0; i < b->num_keys; i++){
+    if (!b->leaf){
+      btree_inorder(b->children[i], f);
+    }
+    f(b->frequencies[i], b->keys[i]);
+  }
+  if (!b->leaf){
+    btree_inorder(b->children[i], f);
+  }
+}
+
+/**
+ * Function: btree_preorder
+ * Purpose: performs a function on the keys of each B-tree node before
+ * visiting the children of the node.
+ *
+ * @param b the root of the B-tree.
+ * @param f another function passed in with parameters freq and str.
+ */
+static void btree_preorder(bnode b, void f(int freq, char *str)){
+  int i;
+
+  for (i = 0; i < b->num_keys; i++){
+    f(b->frequencies[i], b->keys[i]);
+  }
+  for (i = 0; !b->leaf && i <= b->num_keys; i++){
+    btree_preorder(b->children[i], f);
+  }
+}
+
+/**
+ * Function: btree_free
+ * Purpose: frees the nodes of a B-tree.
+ *
+ * @param b the root of the B-tree.
+ */
+static void btree_free(bnode b){
+  int i;
+
+  for (i = 0; !b->leaf && i <= b->num_keys; i++){
+    btree_free(b->children[i]);
+  }
+  free(b);
+}
+
+/**
+ * Function: tree_thaw
+ * Purpose: throws away the frozen copy of the keys of a tree, which no
+ * longer matches the tree once it changes.
+ *
+ * @param t is the tree.
+ */
+static void tree_thaw(tree t){
+
+  if (t->image != NULL){
+    snapshot_unload(t->image, t->image_len);
+    t->image = NULL;
+  } else if (t->frozen != NULL){
+    free(t->frozen);
+    free(t->frozen_offsets);
+    free(t->frozen_prefixes);
+    free(t->frozen_frequencies);
+  }
+  t->frozen = NULL;
+  t->num_frozen = 0;
+}
+
+/**
+ * Function: btree_collect
+ * Purpose: lists the keys of a B-tree in sorted order, along with their
+ * frequencies.
+ *
+ * @param b the root of the B-tree.
+ * @param keys the array to list the keys in.
+ * @param freqs the array to list their frequencies in.
+ * @param n the number of keys listed so far.
+ * @return the number of keys listed afterwards.
+ */
+static int btree_collect(bnode b, char **keys, int *freqs, int n){
+  int i;
+
+  for (i = 0; i < b->num_keys; i++){
+    if (!b->leaf){
+      n = btree_collect(b->children[i], keys, freqs, n);
+    }
+    freqs[n] = b->frequencies[i];
+    keys[n++] = b->keys[i];
+  }
+  if (!b->leaf){
+    n = btree_collect(b->children[i], keys, freqs, n);
+  }
+  return n;
+}
+
+/**
+ * Function: btree_count
+ * Purpose: counts the keys of a B-tree.
+ *
+ * @param b the root of the B-tree.
+ * @return the number of keys.
+ */
+static int btree_count(bnode b){
+  int i, n = b->num_keys;
+
+  for (i = 0; !b->leaf && i <= b->num_keys; i++){
+    n += btree_count(b->children[i]);
+  }
+  return n;
+}
+
+/**
+ * Function: eytzinger
+ * Purpose: lays sorted keys out in Eytzinger order, where the children
+ * of position k are at 2k and 2k + 1, by walking the implicit tree in
+ * order.
+ *
+ * @param placed the array filled with the place in sorted order of the
+ * key at each position from k.
+ * @param n the number of keys.
+ * @param i the number of sorted keys used so far.
+ * @param k the position in the implicit tree.
+ * @return the number of sorted keys used afterwards.
+ */
+static int eytzinger(int *placed, int n, int i, int k){
+
+  if (k <= n){
+    i = eytzinger(placed, n, i, 2 * k);
+    placed[k] = i++;
+    i = eytzinger(placed, n, i, 2 * k + 1);
+  }
+  return i;
+}
+
+/**
+ * Function: tree_freeze
+ * Purpose: copies the keys of the tree into one block in Eytzinger
+ * order for fast searching, with their offsets, prefixes and frequencies
+ * in three arrays in the same order. The keys are copied in position order, so
+ * the first few levels every search goes through end up next to each
+ * other in memory. Searches use the copy instead of the nodes until
+ * the tree is next changed by an insert or remove.
+ *
+ * @param t is the tree.
+ */
+void tree_freeze(tree t){
+  char **sorted, *key;
+  int *freqs, *placed;
+  node n = t->root;
+  uint64_t len = 0;
+  int i, top = 0;
+
+  tree_thaw(t);
+  i = t->broot != NULL ? btree_count(t->broot) : (int) t->num_nodes;
+  sorted = emalloc((i + 1) * sizeof sorted[0]);
+  freqs = emalloc((i + 1) * sizeof freqs[0]);
+  if (t->broot != NULL){
+    t->num_frozen = btree_collect(t->broot, sorted, freqs, 0);
+  }
+  while (n != NIL || top > 0){
+    while (n != NIL){
+      tree_stack(t, top + 1);
+      t->stack[top++] = n;
+      n = LEFT(t, n);
+    }
+    n = t->stack[--top];
+    freqs[t->num_frozen] = t->nodes[n].frequency;
+    sorted[t->num_frozen++] = node_key(t, n);
+    n = RIGHT(t, n);
+  }
+
+  placed = emalloc((t->num_frozen + 1) * sizeof placed[0]);
+  eytzinger(placed, t->num_frozen, 0, 1);
+  for (i = 1; i <= t->num_frozen; i++){
+    len += strlen(sorted[placed[i]]) + 1;
+  }
+  t->frozen_len = len + 1;
+  t->frozen = emalloc(t->frozen_len);
+  t->frozen_offsets = emalloc((t->num_frozen + 1)
+                              * sizeof t->frozen_offsets[0]);
+  t->frozen_prefixes = emalloc((t->num_frozen + 1)
+                               * sizeof t->frozen_prefixes[0]);
+  t->frozen_frequencies = emalloc((t->num_frozen + 1)
+                                  * sizeof t->frozen_frequencies[0]);
+  t->frozen[0] = '\0';
+  t->frozen_offsets[0] = 0;
+  t->frozen_prefixes[0] = 0;
+  t->frozen_frequencies[0] = 0;
+  for (len = 1, i = 1; i <= t->num_frozen; i++){
+    key = sorted[placed[i]];
+    t->frozen_offsets[i] = len;
+    strcpy(t->frozen + len, key);
+    len += strlen(key) + 1;
+    t->frozen_prefixes[i] = key_prefix(key);
+    t->frozen_frequencies[i] = freqs[placed[i]];
+  }
+  free(placed);
+  free(freqs);
+  free(sorted);
+}
+
+/**
+ * Function: tree_save
+ * Purpose: saves the frozen copy of the keys of a tree to a file, which
+ * tree_load can map back in and search without building anything. The
+ * tree is frozen first if it is not already.
+ *
+ * @param t is the tree.
+ * @param filename the file to save to.
+ * @return 0 if the file was written, or -1 if it could not be.
+ */
+int tree_save(tree t, const char *filename){
+  snapshot s = snapshot_new(TREE_MAGIC, sizeof(struct tree_image));
+  struct tree_image header;
+  size_t n;
+
+  if (t->frozen == NULL){
+    tree_freeze(t);
+  }
+  n = t->num_frozen + 1;
+  header.type = t->type;
+  header.num_frozen = t->num_frozen;
+  header.prefixes = snapshot_append(s, t->frozen_prefixes,
+                                    n * sizeof t->frozen_prefixes[0]);
+  header.offsets = snapshot_append(s, t->frozen_offsets,
+                                   n * sizeof t->frozen_offsets[0]);
+  header.frequencies = snapshot_append(s, t->frozen_frequencies,
+                                       n * sizeof t->frozen_frequencies[0]);
+  header.keys = snapshot_append(s, t->frozen, t->frozen_len);
+  header.keys_len = t->frozen_len;
+  memcpy(snapshot_header(s), &header, sizeof header);
+  return snapshot_save(s, filename);
+}
+
+/**
+ * Function: tree_load
+ * Purpose: maps in a tree saved by tree_save. The tree is frozen, with
+ * its arrays where they lie in the file, and can only be searched; it
+ * has none of its keys once it is changed. Every key offset is checked
+ * to lie within the file first.
+ *
+ * @param filename the file to load.
+ * @param verify whether to check the checksum of the whole file too.
+ * @return the tree, or NULL if the file is not a saved tree.
+ */
+tree tree_load(const char *filename, int verify){
+  void *header_start;
+  struct tree_image *header;
+  size_t len, n, i;
+  char *image = snapshot_load(filename, TREE_MAGIC, sizeof *header,
+                              verify, &header_start, &len);
+  uint64_t *offsets;
+  tree t;
+
+  if (image == NULL){
+    return NULL;
+  }
+  header = header_start;
+  n = header->num_frozen + 1;
+  if (header->num_frozen < 0
+      || (header->type != BST && header->type != RBT
+          && header->type != BTREE)
+      || !snapshot_contains(len, header->prefixes,
+                            n * sizeof t->frozen_prefixes[0])
+      || !snapshot_contains(len, header->offsets,
+                            n * sizeof t->frozen_offsets[0])
+      || !snapshot_contains(len, header->frequencies,
+                            n * sizeof t->frozen_frequencies[0])
+      || !snapshot_contains(len, header->keys, header->keys_len)
+      || header->keys_len == 0
+      || image[header->keys + header->keys_len - 1] != '\0'){
+    snapshot_unload(image, len);
+    return NULL;
+  }
+  /* Every key ends before the end of the keys, so an offset within them
+     is enough to keep its key within the file. */
+  offsets = (uint64_t *) (image + header->offsets);
+  for (i = 0; i < n; i++){
+    if (offsets[i] >= header->keys_len){
+      snapshot_unload(image, len);
+      return NULL;
+    }
+  }
+  t = tree_new((tree_t) header->type);
+  t->image = image;
+  t->image_len = len;
+  t->num_frozen = header->num_frozen;
+  t->frozen_prefixes = (uint64_t *) (image + header->prefixes);
+  t->frozen_offsets = (uint64_t *) (image + header->offsets);
+  t->frozen_frequencies = (int32_t *) (image + header->frequencies);
+  t->frozen = image + header->keys;
+  t->frozen_len = header->keys_len;
   return t;
 }
 
+/**
+ * Function: trailing_ones
+ * Purpose: counts the set bits at the bottom of a number.
+ *
+ * @param k the number.
+ * @return how many of its lowest bits are set.
+ */
+static int trailing_ones(unsigned int k){
+#ifdef __GNUC__
+  return __builtin_ctz(~k);
+#else
+  int i = 0;
+
+  while (k & 1){
+    k >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/**
+ * Function: frozen_search
+ * Purpose: searches the frozen array of a tree. The walk down takes the
+ * same number of steps whatever the keys compare as, so it turns the
+ * comparison into an index instead of a branch, and prefetches the
+ * prefixes of the positions three levels further down, which share a
+ * cache line. The last key the search was not greater than is the only
+ * one which can match.
+ *
+ * @param t is the tree.
+ * @param str the string to search for.
+ * @return the frequency of the string, or 0 if it is not a key of the
+ * tree.
+ */
+static int frozen_search(tree t, char *str){
+  uint64_t prefix = key_prefix(str);
+  unsigned int k = 1, n = t->num_frozen;
+
+  while (k <= n){
+    PREFETCH(t->frozen_prefixes + 8 * k);
+    k = 2 * k + (prefix_compare(t->frozen_prefixes[k], FROZEN_KEY(t, k),
+                                prefix, str) < 0);
+  }
+  k >>= trailing_ones(k) + 1;
+  if (k != 0 && prefix_compare(t->frozen_prefixes[k], FROZEN_KEY(t, k),
+                               prefix, str) == 0){
+    return t->frozen_frequencies[k];
+  }
+  return 0;
+}
+
 /**
  * Function: tree_free
- * Purpose: frees all the memory allocated to the tree. 
+ * Purpose: frees all the memory allocated to the tree. The nodes of a
+ * bst or rbt all live in one pool and their long keys in one arena, so
+ * both go back in a single call each.
  *
  * @param t is the tree.
- * @return t the freed tree. 
  */
-tree tree_free(tree t){
+void tree_free(tree t){
 
-  if (t == NULL){
-    return t;
-  } else {
-    tree_free(t->left);
-    tree_free(t->right);
-    free(t->key);
-    free(t);
-    return t;
+  tree_thaw(t);
+  if (t->broot != NULL){
+    btree_free(t->broot);
   }
+  free(t->nodes);
+  arena_free(t->key_arena);
+  free(t->stack);
+  free(t);
 }
 
 /**
@@ -190,13 +1128,71 @@ tree tree_free(tree t){
  * @param str the string to search. 
  */
 void tree_inorder(tree t, void f(int freq, char *str)){
+  node n = t->root;
+  int top = 0;
 
-  if (t == NULL){
-    return;
+  if (t->broot != NULL){
+    btree_inorder(t->broot, f);
+  }
+  while (n != NIL || top > 0){
+    while (n != NIL){
+      tree_stack(t, top + 1);
+      t->stack[top++] = n;
+      n = LEFT(t, n);
+    }
+    n = t->stack[--top];
+    f(t->nodes[n].frequency, node_key(t, n));
+    n = RIGHT(t, n);
   }
-  tree_inorder(t->left, f);
-  f(t->frequency, t->key);
-  tree_inorder(t->right, f);
+}
+
+/**
+ * Function: tree_insert_freq
+ * Purpose: inserts a string into the tree with the given frequency, or
+ * adds the frequency to it if it is already there. The tree is walked
+ * down without recursion, keeping the path on the stack of the tree for
+ * tree_fix.
+ *
+ * @param t is the tree.
+ * @param str is a pointer to the string to be inserted.
+ * @param freq how many times the string is being inserted.
+ * @return the frequency of the string afterwards.
+ */
+int tree_insert_freq(tree t, char *str, int freq){
+  node n = t->root;
+  uint64_t prefix;
+  int cmp, depth = 0;
+
+  tree_thaw(t);
+  if (t->type == BTREE){
+    return btree_insert(t, str, freq);
+  }
+  prefix = key_prefix(str);
+  while (n != NIL){
+    cmp = prefix_compare(prefix, str, t->nodes[n].prefix, node_key(t, n));
+    if (cmp == 0){
+      t->nodes[n].frequency += freq;
+      return t->nodes[n].frequency;
+    }
+    tree_stack(t, depth + 2);
+    t->stack[depth++] = n;
+    n = cmp > 0 ? RIGHT(t, n) : LEFT(t, n);
+  }
+
+  n = node_new(t, str, freq);
+  t->stack[depth] = n;
+  if (depth == 0){
+    t->root = n;
+  } else if (cmp > 0){
+    set_right(t, t->stack[depth - 1], n);
+  } else {
+    set_left(t, t->stack[depth - 1], n);
+  }
+
+  if (t->type == RBT){
+    tree_fix(t, depth);
+  }
+  return freq;
 }
 
 /**
@@ -205,59 +1201,257 @@ void tree_inorder(tree t, void f(int freq, char *str)){
  *
  * @param t is the tree.
  * @param str is a pointer to the string to be inserted.
- * @return t the new tree with inserted pointer to string. 
+ * @return 1 if the string is new, or its frequency if it was already
+ * in the tree.
+ */
+int tree_insert(tree t, char *str){
+
+  return tree_insert_freq(t, str, 1);
+}
+
+/**
+ * Function: build_sorted
+ * Purpose: builds a balanced subtree from a run of sorted keys, with the
+ * middle key at the root and each half built the same way below it.
+ *
+ * @param t is the tree.
+ * @param keys the keys in sorted order.
+ * @param freqs the frequency of each key.
+ * @param low the first key of the run.
+ * @param high the last key of the run.
+ * @param depth the depth of the root of the subtree.
+ * @param red_depth the depth whose nodes are coloured red.
+ * @return the root of the subtree.
  */
-tree tree_insert(tree t, char *str){
+static node build_sorted(tree t, char **keys, int *freqs, int low, int high,
+                         int depth, int red_depth){
+  int mid = low + (high - low) / 2;
+  node n;
+
+  if (low > high){
+    return NIL;
+  }
+  n = node_new(t, keys[mid], freqs[mid]);
+  set_colour(t, n, depth == red_depth ? RED : BLACK);
+  set_left(t, n, build_sorted(t, keys, freqs, low, mid - 1, depth + 1,
+                              red_depth));
+  set_right(t, n, build_sorted(t, keys, freqs, mid + 1, high, depth + 1,
+                               red_depth));
+  return n;
+}
 
-  if (t == NULL || t->key == NULL){
+/**
+ * Function: tree_build_sorted
+ * Purpose: fills an empty tree from keys in sorted order in linear time,
+ * giving a tree of the smallest height. Every node is black apart from
+ * those on the deepest level, which are red so that paths ending one
+ * level higher have the same number of black nodes. A tree which is not
+ * empty, or a btree, has the keys inserted one at a time instead.
+ *
+ * @param t is the tree.
+ * @param keys the keys in strictly increasing order.
+ * @param freqs the frequency of each key.
+ * @param n the number of keys.
+ */
+void tree_build_sorted(tree t, char **keys, int *freqs, int n){
+  int i, height;
 
-    if (t == NULL){
-      t = tree_new(tree_type);
+  if (t->type == BTREE || t->root != NIL){
+    for (i = 0; i < n; i++){
+      tree_insert_freq(t, keys[i], freqs[i]);
     }
-    t->key = emalloc(strlen(str) * sizeof str[0] + 1);
-    if (tree_type == RBT){
-      t->colour = RED;
+    return;
+  }
+  tree_thaw(t);
+  for (height = 0; (2 << height) <= n; height++)
+    ;
+  t->root = build_sorted(t, keys, freqs, 0, n - 1, 0,
+                         height > 0 ? height : -1);
+}
+
+/**
+ * Function: remove_fix_left
+ * Purpose: restores the red-black properties of a subtree whose left
+ * subtree has lost one black node from every path.
+ *
+ * @param t is the tree.
+ * @param n is the root of the subtree.
+ * @param shorter set to 1 if the whole subtree is still a black node
+ * short, 0 if the loss has been made up.
+ * @return the fixed subtree.
+ */
+static node remove_fix_left(tree t, node n, int *shorter){
+  node s = RIGHT(t, n);
+
+  *shorter = 0;
+  if (IS_RED(t, s)){
+    n = left_rotate(t, n);
+    set_colour(t, n, BLACK);
+    set_colour(t, LEFT(t, n), RED);
+    set_left(t, n, remove_fix_left(t, LEFT(t, n), shorter));
+  } else if (IS_BLACK(t, LEFT(t, s)) && IS_BLACK(t, RIGHT(t, s))){
+    set_colour(t, s, RED);
+    if (IS_RED(t, n)){
+      set_colour(t, n, BLACK);
+    } else {
+      *shorter = 1;
     }
-    strcpy(t->key, str);
-    t->frequency = 1;
-  } else if (strcmp(t->key, str) == 0){
-    t->frequency++;
-  } else if (strcmp(str, t->key) > 0){
-    t->right = tree_insert(t->right, str);
   } else {
-    t->left = tree_insert(t->left, str);
+    if (IS_BLACK(t, RIGHT(t, s))){
+      set_right(t, n, right_rotate(t, s));
+      set_colour(t, RIGHT(t, n), BLACK);
+      set_colour(t, s, RED);
+    }
+    s = RIGHT(t, n);
+    set_colour(t, s, IS_RED(t, n) ? RED : BLACK);
+    set_colour(t, n, BLACK);
+    set_colour(t, RIGHT(t, s), BLACK);
+    n = left_rotate(t, n);
   }
+  return n;
+}
+
+/**
+ * Function: remove_fix_right
+ * Purpose: restores the red-black properties of a subtree whose right
+ * subtree has lost one black node from every path.
+ *
+ * @param t is the tree.
+ * @param n is the root of the subtree.
+ * @param shorter set to 1 if the whole subtree is still a black node
+ * short, 0 if the loss has been made up.
+ * @return the fixed subtree.
+ */
+static node remove_fix_right(tree t, node n, int *shorter){
+  node s = LEFT(t, n);
 
-  if (root_node == NULL){
-    root_node = t;
+  *shorter = 0;
+  if (IS_RED(t, s)){
+    n = right_rotate(t, n);
+    set_colour(t, n, BLACK);
+    set_colour(t, RIGHT(t, n), RED);
+    set_right(t, n, remove_fix_right(t, RIGHT(t, n), shorter));
+  } else if (IS_BLACK(t, LEFT(t, s)) && IS_BLACK(t, RIGHT(t, s))){
+    set_colour(t, s, RED);
+    if (IS_RED(t, n)){
+      set_colour(t, n, BLACK);
+    } else {
+      *shorter = 1;
+    }
+  } else {
+    if (IS_BLACK(t, LEFT(t, s))){
+      set_left(t, n, left_rotate(t, s));
+      set_colour(t, LEFT(t, n), BLACK);
+      set_colour(t, s, RED);
+    }
+    s = LEFT(t, n);
+    set_colour(t, s, IS_RED(t, n) ? RED : BLACK);
+    set_colour(t, n, BLACK);
+    set_colour(t, LEFT(t, s), BLACK);
+    n = right_rotate(t, n);
   }
-   
-  if (tree_type == RBT){
-    t = tree_fix(t);
+  return n;
+}
+
+/**
+ * Function: tree_remove
+ * Purpose: removes a string from the tree, keeping an rbt balanced. The
+ * nodes on the path from the root down to the node taken out are kept
+ * on the stack of the tree, and if that leaves an rbt a black node short
+ * the colours are fixed from the bottom of the path back up.
+ *
+ * @param t is the tree.
+ * @param str is a pointer to the string to be removed.
+ * @return the frequency the string had, or 0 if it was not in the tree.
+ */
+int tree_remove(tree t, char *str){
+  node n = t->root, child, parent;
+  uint64_t prefix;
+  int cmp, depth = 0, freq, shorter = 0;
+
+  tree_thaw(t);
+  if (t->type == BTREE){
+    return btree_remove(t, str);
   }
-    
-  return t;
+  prefix = key_prefix(str);
+  while (n != NIL){
+    cmp = prefix_compare(prefix, str, t->nodes[n].prefix, node_key(t, n));
+    if (cmp == 0){
+      break;
+    }
+    tree_stack(t, depth + 1);
+    t->stack[depth++] = n;
+    n = cmp > 0 ? RIGHT(t, n) : LEFT(t, n);
+  }
+  if (n == NIL){
+    return 0;
+  }
+
+  freq = t->nodes[n].frequency;
+  if (LEFT(t, n) != NIL && RIGHT(t, n) != NIL){
+    /* Take the key of the next string in order, and take that node
+       out of the right subtree instead. */
+    tree_stack(t, depth + 1);
+    t->stack[depth++] = n;
+    for (child = RIGHT(t, n); LEFT(t, child) != NIL; child = LEFT(t, child)){
+      tree_stack(t, depth + 1);
+      t->stack[depth++] = child;
+    }
+    copy_key(t, n, child);
+    n = child;
+  }
+
+  child = LEFT(t, n) != NIL ? LEFT(t, n) : RIGHT(t, n);
+  if (IS_RED(t, child)){
+    set_colour(t, child, BLACK);
+  } else if (IS_BLACK(t, n)){
+    shorter = 1;
+  }
+  relink(t, depth > 0 ? t->stack[depth - 1] : NIL, n, child);
+  node_release(t, n);
+
+  /* A subtree a black node short always has a sibling, so even an empty
+     child can tell which side of its parent it is on. */
+  while (shorter && t->type == RBT && depth > 0){
+    parent = t->stack[--depth];
+    n = LEFT(t, parent) == child ? remove_fix_left(t, parent, &shorter)
+      : remove_fix_right(t, parent, &shorter);
+    relink(t, depth > 0 ? t->stack[depth - 1] : NIL, parent, n);
+    child = n;
+  }
+  if (t->root != NIL){
+    set_colour(t, t->root, BLACK);
+  }
+  return freq;
 }
 
 /**
  * Function: tree_new
  * Purpose: creates a new tree. 
  *
- * @param type determines whether the tree is an ordinary bst or balanced rbt.
+ * @param type determines whether the tree is an ordinary bst, a balanced
+ * rbt or a btree.
  * @return t the created tree. 
  */
 tree tree_new(tree_t type){
 
   tree t;
     
-  tree_type = type;
-  
   t = emalloc(sizeof *t);
-  t->key = NULL;
-  t->colour = RED;
-  t->left = NULL;
-  t->right = NULL;
-  t->frequency = 0;
+  t->root = NIL;
+  t->pool_size = 1024;
+  t->nodes = emalloc(t->pool_size * sizeof t->nodes[0]);
+  t->num_nodes = 0;
+  t->free_nodes = NIL;
+  t->broot = NULL;
+  t->type = type;
+  t->key_arena = arena_new();
+  t->stack_size = 64;
+  t->stack = emalloc(t->stack_size * sizeof t->stack[0]);
+  t->frozen = NULL;
+  t->frozen_frequencies = NULL;
+  t->num_frozen = 0;
+  t->image = NULL;
 
   return t;
 
@@ -274,13 +1468,26 @@ tree tree_new(tree_t type){
  * @param str the string to search. 
  */
 void tree_preorder(tree t, void f(int freq, char *str)){
+  node n;
+  int top = 0;
 
-  if (t == NULL){
-    return;
+  if (t->broot != NULL){
+    btree_preorder(t->broot, f);
+  }
+  if (t->root != NIL){
+    t->stack[top++] = t->root;
+  }
+  while (top > 0){
+    n = t->stack[--top];
+    f(t->nodes[n].frequency, node_key(t, n));
+    tree_stack(t, top + 2);
+    if (RIGHT(t, n) != NIL){
+      t->stack[top++] = RIGHT(t, n);
+    }
+    if (LEFT(t, n) != NIL){
+      t->stack[top++] = LEFT(t, n);
+    }
   }
-  f(t->frequency, t->key);
-  tree_preorder(t->left, f);
-  tree_preorder(t->right, f);
 }
 
 /**
@@ -289,19 +1496,192 @@ void tree_preorder(tree t, void f(int freq, char *str)){
  *
  * @param t is the tree.
  * @param str is a pointer to the string to be inserted.
- * @return 1 if the string exists in the tree, 0 if not.  
+ * @return the frequency of the string, or 0 if it is not in the tree.
  */
 int tree_search(tree t, char *str){
+  node n = t->root;
+  bnode b;
+  uint64_t prefix;
+  int cmp, i;
 
-  if (t == NULL){
-    return 0;
-  } else if (strcmp(str, t->key) == 0){
-    return 1;
-  } else if (strcmp(str, t->key) > 0){
-    return tree_search(t->right, str);
-  } else {
-    return tree_search(t->left, str);
+  if (t->frozen != NULL){
+    return frozen_search(t, str);
   }
+  if (t->type == BTREE){
+    b = btree_search(t->broot, str, &i);
+    return b != NULL ? b->frequencies[i] : 0;
+  }
+  prefix = key_prefix(str);
+  while (n != NIL){
+    cmp = prefix_compare(prefix, str, t->nodes[n].prefix, node_key(t, n));
+    if (cmp == 0){
+      return t->nodes[n].frequency;
+    }
+    n = cmp > 0 ? RIGHT(t, n) : LEFT(t, n);
+  }
+  return 0;
+}
+
+/**
+ * Function: btree_search_batch
+ * Purpose: searches a B-tree for many strings at once, moving the
+ * searches down the tree together one level per pass like
+ * tree_search_batch. Each node is several cache lines long, so both
+ * lines of prefixes of the next node are prefetched, which are all a
+ * search reads from it unless prefixes tie.
+ *
+ * @param b the root of the B-tree.
+ * @param words the strings to search for.
+ * @param n the number of strings.
+ * @param results set to the frequency of each string in the tree, 0 for
+ * the others.
+ */
+static void btree_search_batch(bnode b, char **words, int n, int *results){
+
+  bnode *nodes = emalloc((n + 1) * sizeof nodes[0]);
+  uint64_t *prefixes = emalloc((n + 1) * sizeof prefixes[0]);
+  int i, j, found, active = 0;
+
+  for (i = 0; i < n; i++){
+    nodes[i] = b;
+    prefixes[i] = key_prefix(words[i]);
+    results[i] = 0;
+    if (nodes[i] != NULL){
+      active++;
+    }
+  }
+  while (active > 0){
+    for (i = 0; i < n; i++){
+      if (nodes[i] == NULL){
+        continue;
+      }
+      j = btree_find(nodes[i], prefixes[i], words[i], &found);
+      if (found || nodes[i]->leaf){
+        results[i] = found ? nodes[i]->frequencies[j] : 0;
+        nodes[i] = NULL;
+        active--;
+      } else {
+        nodes[i] = nodes[i]->children[j];
+        PREFETCH(nodes[i]);
+        PREFETCH((char *) nodes[i]->prefixes + 64);
+      }
+    }
+  }
+  free(prefixes);
+  free(nodes);
+}
+
+/**
+ * Function: frozen_search_batch
+ * Purpose: searches the frozen array of a tree for many strings at once.
+ * Every search takes about the same number of steps, so they move down
+ * together a level per pass, prefetching the prefix each one compares
+ * with next while the others are compared.
+ *
+ * @param t is the tree.
+ * @param words the strings to search for.
+ * @param n the number of strings.
+ * @param results set to the frequency of each string in the tree, 0 for
+ * the others.
+ */
+static void frozen_search_batch(tree t, char **words, int n, int *results){
+
+  unsigned int *at = emalloc((n + 1) * sizeof at[0]);
+  uint64_t *prefixes = emalloc((n + 1) * sizeof prefixes[0]);
+  unsigned int k, size = t->num_frozen;
+  int i, active = 1;
+
+  for (i = 0; i < n; i++){
+    at[i] = 1;
+    prefixes[i] = key_prefix(words[i]);
+  }
+  while (active){
+    active = 0;
+    for (i = 0; i < n; i++){
+      k = at[i];
+      if (k <= size){
+        k = 2 * k + (prefix_compare(t->frozen_prefixes[k], FROZEN_KEY(t, k),
+                                    prefixes[i], words[i]) < 0);
+        if (k <= size){
+          PREFETCH(&t->frozen_prefixes[k]);
+          active = 1;
+        }
+        at[i] = k;
+      }
+    }
+  }
+  for (i = 0; i < n; i++){
+    k = at[i] >> (trailing_ones(at[i]) + 1);
+    results[i] = 0;
+    if (k != 0 && prefix_compare(t->frozen_prefixes[k], FROZEN_KEY(t, k),
+                                 prefixes[i], words[i]) == 0){
+      results[i] = t->frozen_frequencies[k];
+    }
+  }
+  free(prefixes);
+  free(at);
+}
+
+/**
+ * Function: tree_search_batch
+ * Purpose: searches the tree for many strings at once. The searches move
+ * down the tree together, one level per pass, and the next node of each
+ * is prefetched as it is chosen. The cache misses of one level of every
+ * search then overlap instead of being paid one after another.
+ *
+ * @param t is the tree.
+ * @param words the strings to search for.
+ * @param n the number of strings.
+ * @param results set to the frequency of each string in the tree, 0 for
+ * the others.
+ */
+void tree_search_batch(tree t, char **words, int n, int *results){
+
+  node *nodes;
+  uint64_t *prefixes;
+  int i, cmp, active = 0;
+
+  if (t->frozen != NULL){
+    frozen_search_batch(t, words, n, results);
+    return;
+  }
+  if (t->type == BTREE){
+    btree_search_batch(t->broot, words, n, results);
+    return;
+  }
+  nodes = emalloc((n + 1) * sizeof nodes[0]);
+  prefixes = emalloc((n + 1) * sizeof prefixes[0]);
+  for (i = 0; i < n; i++){
+    nodes[i] = t->root;
+    prefixes[i] = key_prefix(words[i]);
+    results[i] = 0;
+    if (nodes[i] != NIL){
+      active++;
+    }
+  }
+  while (active > 0){
+    for (i = 0; i < n; i++){
+      if (nodes[i] == NIL){
+        continue;
+      }
+      cmp = prefix_compare(prefixes[i], words[i], t->nodes[nodes[i]].prefix,
+                           node_key(t, nodes[i]));
+      if (cmp == 0){
+        results[i] = t->nodes[nodes[i]].frequency;
+        nodes[i] = NIL;
+        active--;
+      } else {
+        nodes[i] = cmp > 0 ? RIGHT(t, nodes[i]) : LEFT(t, nodes[i]);
+        if (nodes[i] == NIL){
+          active--;
+        } else {
+          PREFETCH(&t->nodes[nodes[i]]);
+        }
+      }
+    }
+  }
+  free(prefixes);
+  free(nodes);
 }
 
 
@@ -309,22 +1689,45 @@ int tree_search(tree t, char *str){
  * Traverses the tree writing a DOT description about connections, and
  * possibly colours, to the given output stream.
  *
- * @param t the tree to output a DOT description of.
+ * @param t the tree.
+ * @param n the subtree to output a DOT description of.
  * @param out the stream to write the DOT output to.
  */
-static void tree_output_dot_aux(tree t, FILE *out) {
-  if(t->key != NULL) {
-    fprintf(out, "\"%s\"[label=\"{<f0>%s:%d|{<f1>|<f2>}}\"color=%s];\n",
-	    t->key, t->key, t->frequency,
-	    (RBT == tree_type && RED == t->colour) ? "red":"black");
+static void tree_output_dot_aux(tree t, node n, FILE *out) {
+  fprintf(out, "\"%s\"[label=\"{<f0>%s:%d|{<f1>|<f2>}}\"color=%s];\n",
+          node_key(t, n), node_key(t, n), t->nodes[n].frequency,
+          (RBT == t->type && IS_RED(t, n)) ? "red":"black");
+  if(LEFT(t, n) != NIL) {
+    tree_output_dot_aux(t, LEFT(t, n), out);
+    fprintf(out, "\"%s\":f1 -> \"%s\":f0;\n", node_key(t, n),
+            node_key(t, LEFT(t, n)));
   }
-  if(t->left != NULL) {
-    tree_output_dot_aux(t->left, out);
-    fprintf(out, "\"%s\":f1 -> \"%s\":f0;\n", t->key, t->left->key);
+  if(RIGHT(t, n) != NIL) {
+    tree_output_dot_aux(t, RIGHT(t, n), out);
+    fprintf(out, "\"%s\":f2 -> \"%s\":f0;\n", node_key(t, n),
+            node_key(t, RIGHT(t, n)));
   }
-  if(t->right != NULL) {
-    tree_output_dot_aux(t->right, out);
-    fprintf(out, "\"%s\":f2 -> \"%s\":f0;\n", t->key, t->right->key);
+}
+
+/**
+ * Writes a DOT description of a B-tree to the given output stream, with
+ * one record node per B-tree node.
+ *
+ * @param b the subtree to output a DOT description of.
+ * @param out the stream to write the DOT output to.
+ */
+static void btree_output_dot_aux(bnode b, FILE *out) {
+  int i;
+
+  fprintf(out, "\"%p\"[label=\"", (void *) b);
+  for (i = 0; i < b->num_keys; i++) {
+    fprintf(out, "<c%d>|%s:%d|", i, b->keys[i], b->frequencies[i]);
+  }
+  fprintf(out, "<c%d>\"];\n", i);
+  for (i = 0; !b->leaf && i <= b->num_keys; i++) {
+    btree_output_dot_aux(b->children[i], out);
+    fprintf(out, "\"%p\":c%d -> \"%p\";\n", (void *) b, i,
+            (void *) b->children[i]);
   }
 }
 
@@ -342,8 +1745,11 @@ static void tree_output_dot_aux(tree t, FILE *out) {
  */
 void tree_output_dot(tree t, FILE *out) {
   fprintf(out, "digraph tree {\nnode [shape = Mrecord, penwidth = 2];\n");
-  tree_output_dot_aux(t, out);
+  if (t->root != NIL) {
+    tree_output_dot_aux(t, t->root, out);
+  }
+  if (t->broot != NULL) {
+    btree_output_dot_aux(t->broot, out);
+  }
   fprintf(out, "}\n");
 }
-
-
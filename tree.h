@@ -7,26 +7,34 @@
 #define TREE_H_
 
 /**
- * Struct: tree_node
- * Purpose: defines a struct type of tree_node to structure a tree node
+ * Struct: treerec
+ * Purpose: defines a struct type of treerec to structure a tree, which
+ * owns its nodes.
  */
-typedef struct tree_node *tree;
+typedef struct treerec *tree;
 
 typedef enum { RED, BLACK } tree_colour;
 
-typedef enum tree_e { BST, RBT } tree_t;
+typedef enum tree_e { BST, RBT, BTREE } tree_t;
 
 /**
  * Prototypes
  * Purpose: specifies functions to be implemented in the tree.c file, based on
  * their signatures.
  */
-extern tree tree_free(tree t);
+extern void tree_build_sorted(tree t, char **keys, int *freqs, int n);
+extern void tree_free(tree t);
+extern void tree_freeze(tree t);
 extern void tree_inorder(tree t, void f(int freq, char *str));
-extern tree tree_insert(tree t, char *str);
+extern int tree_insert(tree t, char *str);
+extern int tree_insert_freq(tree t, char *str, int freq);
+extern tree tree_load(const char *filename, int verify);
 extern tree tree_new(tree_t type);
+extern int tree_remove(tree t, char *str);
 extern void tree_preorder(tree t, void f(int freq, char *str));
+extern int tree_save(tree t, const char *filename);
 extern int tree_search(tree t, char *str);
+extern void tree_search_batch(tree t, char **words, int n, int *results);
 extern void tree_output_dot(tree t, FILE *out);
 
 #endif